@@ -25,6 +25,7 @@ cmake --build . --config Release
 echo copying binaries to the distrib folder...
 copy /Y *.exe "%distrib_dir%"
 copy /Y *.dll "%distrib_dir%"
+copy /Y font.atlas "%distrib_dir%"
 copy /Y ..\font.ttf "%distrib_dir%"
 copy /Y ..\smiley.png "%distrib_dir%"
 popd
@@ -0,0 +1,331 @@
+#include "Bvh.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+
+namespace {
+    const int BinCount = 16;
+    const uint32_t MaxLeafSize = 8;  // Larger ranges are split even when the heuristic prefers a leaf
+    const float TraversalCost = 1.0f; // Visiting a node, relative to testing a box
+    const int MaxSahDepth = 48;      // Deeper nodes split at the median, so the depth stays under StackSize
+    const int StackSize = 96;
+
+    struct Bounds {
+        glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+        glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+        void grow(const glm::vec3& point) {
+            min = glm::min(min, point);
+            max = glm::max(max, point);
+        }
+        void grow(const BvhBox& box) {
+            min = glm::min(min, box.min);
+            max = glm::max(max, box.max);
+        }
+        void grow(const Bounds& other) {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+        float area() const {
+            glm::vec3 size = max - min;
+            return size.x < 0.0f ? 0.0f : size.x * size.y + size.y * size.z + size.z * size.x;
+        }
+    };
+
+    void setBounds(BvhNode& node, const Bounds& bounds) {
+        for (int axis = 0; axis < 3; ++axis) {
+            node.min[axis] = bounds.min[axis];
+            node.max[axis] = bounds.max[axis];
+        }
+    }
+
+    struct Bin {
+        Bounds bounds;
+        uint32_t count = 0;
+    };
+
+    struct Builder {
+        const std::vector<BvhBox>& boxes;
+        std::vector<glm::vec3> centroids;
+        uint32_t* indices;
+        BvhNode* nodes;
+        std::atomic<uint32_t> nodeCount{ 1 };
+
+        Builder(const std::vector<BvhBox>& boxes, uint32_t* indices, BvhNode* nodes)
+            : boxes(boxes), centroids(boxes.size()), indices(indices), nodes(nodes) {
+            for (size_t i = 0; i < boxes.size(); ++i)
+                centroids[i] = (boxes[i].min + boxes[i].max) * 0.5f;
+        }
+
+        // Split [first, first + count) of the index array under nodeIndex
+        void build(uint32_t nodeIndex, uint32_t first, uint32_t count, int depth, JobSystem* jobs) {
+            Bounds bounds, centroidBounds;
+            for (uint32_t i = first; i < first + count; ++i) {
+                bounds.grow(boxes[indices[i]]);
+                centroidBounds.grow(centroids[indices[i]]);
+            }
+            BvhNode& node = nodes[nodeIndex];
+            setBounds(node, bounds);
+            node.first = first;
+            node.count = count;
+            if (count <= 2)
+                return;
+
+            uint32_t leftCount = depth < MaxSahDepth ? splitSah(first, count, bounds, centroidBounds) : 0;
+            if (leftCount == count)
+                return; // The heuristic prefers a leaf
+            if (leftCount == 0)
+                leftCount = splitMedian(first, count, centroidBounds);
+
+            uint32_t left = nodeCount.fetch_add(2);
+            node.first = left;
+            node.count = 0;
+            if (jobs && count > Bvh::ParallelBuildThreshold) {
+                // Another thread can steal the left half while this one builds the right
+                JobHandle leftJob = jobs->submit([=, this] { build(left, first, leftCount, depth + 1, jobs); });
+                build(left + 1, first + leftCount, count - leftCount, depth + 1, jobs);
+                jobs->wait(leftJob);
+            } else {
+                build(left, first, leftCount, depth + 1, nullptr);
+                build(left + 1, first + leftCount, count - leftCount, depth + 1, nullptr);
+            }
+        }
+
+        // Partition the range at the cheapest bin boundary and return the size of the left part.
+        // count when a leaf is cheaper, 0 when the centroids can't be told apart.
+        uint32_t splitSah(uint32_t first, uint32_t count, const Bounds& bounds, const Bounds& centroidBounds) {
+            int bestAxis = -1, bestSplit = 0;
+            float bestCost = std::numeric_limits<float>::max();
+            for (int axis = 0; axis < 3; ++axis) {
+                float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+                if (extent <= 0.0f)
+                    continue;
+                Bin bins[BinCount];
+                float scale = BinCount / extent;
+                for (uint32_t i = first; i < first + count; ++i) {
+                    uint32_t box = indices[i];
+                    int bin = std::min(BinCount - 1, (int)((centroids[box][axis] - centroidBounds.min[axis]) * scale));
+                    bins[bin].count++;
+                    bins[bin].bounds.grow(boxes[box]);
+                }
+                // Sweep from the right for the right side's area and count at each boundary, then from the left
+                float rightCost[BinCount];
+                Bounds right;
+                uint32_t rightCount = 0;
+                for (int split = BinCount - 1; split > 0; --split) {
+                    right.grow(bins[split].bounds);
+                    rightCount += bins[split].count;
+                    rightCost[split] = right.area() * rightCount;
+                }
+                Bounds left;
+                uint32_t leftCount = 0;
+                for (int split = 1; split < BinCount; ++split) {
+                    left.grow(bins[split - 1].bounds);
+                    leftCount += bins[split - 1].count;
+                    if (leftCount == 0 || leftCount == count)
+                        continue;
+                    float cost = left.area() * leftCount + rightCost[split];
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+            if (bestAxis < 0)
+                return 0;
+            float area = bounds.area();
+            if (count <= MaxLeafSize && (area <= 0.0f || TraversalCost + bestCost / area >= (float)count))
+                return count;
+
+            float scale = BinCount / (centroidBounds.max[bestAxis] - centroidBounds.min[bestAxis]);
+            float origin = centroidBounds.min[bestAxis];
+            uint32_t* middle = std::partition(indices + first, indices + first + count, [&](uint32_t box) {
+                return std::min(BinCount - 1, (int)((centroids[box][bestAxis] - origin) * scale)) < bestSplit;
+            });
+            uint32_t leftCount = (uint32_t)(middle - (indices + first));
+            return leftCount == count ? 0 : leftCount;
+        }
+
+        // Split the range in half along the widest centroid axis
+        uint32_t splitMedian(uint32_t first, uint32_t count, const Bounds& centroidBounds) {
+            glm::vec3 extent = centroidBounds.max - centroidBounds.min;
+            int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+            uint32_t half = count / 2;
+            std::nth_element(indices + first, indices + first + half, indices + first + count,
+                             [&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+            return half;
+        }
+    };
+
+    // Whether box lies outside one of the planes, and whether it lies inside all of them
+    void classify(const float planes[6][4], const float absPlanes[6][4], const float* min, const float* max, bool& outside, bool& inside) {
+        float center[3] = { (min[0] + max[0]) * 0.5f, (min[1] + max[1]) * 0.5f, (min[2] + max[2]) * 0.5f };
+        float half[3] = { (max[0] - min[0]) * 0.5f, (max[1] - min[1]) * 0.5f, (max[2] - min[2]) * 0.5f };
+        outside = false;
+        inside = true;
+        for (int p = 0; p < 6; ++p) {
+            float distance = planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] + planes[p][3];
+            float radius = absPlanes[p][0] * half[0] + absPlanes[p][1] * half[1] + absPlanes[p][2] * half[2];
+            if (distance + radius < 0.0f) {
+                outside = true;
+                return;
+            }
+            inside = inside && distance - radius >= 0.0f;
+        }
+    }
+
+    // Entry distance of the ray into the box, or false if it misses it within maxDistance
+    bool intersectRay(const float* min, const float* max, const glm::vec3& origin, const glm::vec3& inverseDirection,
+                      float maxDistance, float& entry) {
+        float enter = 0.0f, exit = maxDistance;
+        for (int axis = 0; axis < 3; ++axis) {
+            float t0 = (min[axis] - origin[axis]) * inverseDirection[axis];
+            float t1 = (max[axis] - origin[axis]) * inverseDirection[axis];
+            enter = std::max(enter, std::min(t0, t1));
+            exit = std::min(exit, std::max(t0, t1));
+        }
+        entry = enter;
+        return enter <= exit;
+    }
+}
+
+void Bvh::build(const std::vector<BvhBox>& boxes, JobSystem* jobs) {
+    clear();
+    if (boxes.empty())
+        return;
+
+    boxIndices.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+        boxIndices[i] = (uint32_t)i;
+    nodes.resize(2 * boxes.size() - 1); // The most a binary tree over them can have
+    Builder builder(boxes, boxIndices.data(), nodes.data());
+    builder.build(0, 0, (uint32_t)boxes.size(), 0, jobs && jobs->threadCount() > 1 ? jobs : nullptr);
+    nodes.resize(builder.nodeCount.load());
+    nodes.shrink_to_fit();
+
+    leafBoxes.resize(boxes.size());
+    for (size_t i = 0; i < boxIndices.size(); ++i)
+        leafBoxes[i] = boxes[boxIndices[i]];
+}
+
+void Bvh::refit(const std::vector<BvhBox>& boxes) {
+    if (boxes.size() != boxIndices.size())
+        return;
+    for (size_t i = 0; i < boxIndices.size(); ++i)
+        leafBoxes[i] = boxes[boxIndices[i]];
+    // Children are always stored after their parent, so walking backwards refits them first
+    for (size_t n = nodes.size(); n-- > 0;) {
+        BvhNode& node = nodes[n];
+        Bounds bounds;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i)
+                bounds.grow(leafBoxes[i]);
+        } else {
+            for (uint32_t child = node.first; child < node.first + 2; ++child) {
+                bounds.grow(glm::vec3(nodes[child].min[0], nodes[child].min[1], nodes[child].min[2]));
+                bounds.grow(glm::vec3(nodes[child].max[0], nodes[child].max[1], nodes[child].max[2]));
+            }
+        }
+        setBounds(node, bounds);
+    }
+}
+
+void Bvh::clear() {
+    nodes.clear();
+    boxIndices.clear();
+    leafBoxes.clear();
+}
+
+size_t Bvh::cull(const Frustum& frustum, uint32_t* visible) const {
+    if (nodes.empty())
+        return 0;
+    float planes[6][4], absPlanes[6][4];
+    for (int p = 0; p < 6; ++p) {
+        for (int c = 0; c < 4; ++c) {
+            planes[p][c] = frustum.planes[p][c];
+            absPlanes[p][c] = std::fabs(frustum.planes[p][c]);
+        }
+    }
+
+    uint32_t stack[StackSize];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    size_t visibleCount = 0;
+    while (stackSize > 0) {
+        const BvhNode& node = nodes[stack[--stackSize]];
+        bool outside, inside;
+        classify(planes, absPlanes, node.min, node.max, outside, inside);
+        if (outside)
+            continue;
+        if (inside) {
+            // A subtree's boxes are one run of the index array, from its leftmost leaf to its rightmost
+            const BvhNode* leftmost = &node;
+            while (leftmost->count == 0)
+                leftmost = &nodes[leftmost->first];
+            const BvhNode* rightmost = &node;
+            while (rightmost->count == 0)
+                rightmost = &nodes[rightmost->first + 1];
+            for (uint32_t i = leftmost->first; i < rightmost->first + rightmost->count; ++i)
+                visible[visibleCount++] = boxIndices[i];
+        } else if (node.count == 0) {
+            stack[stackSize++] = node.first + 1;
+            stack[stackSize++] = node.first;
+        } else {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                bool outside, boxInside;
+                classify(planes, absPlanes, &leafBoxes[i].min.x, &leafBoxes[i].max.x, outside, boxInside);
+                visible[visibleCount] = boxIndices[i];
+                visibleCount += !outside;
+            }
+        }
+    }
+    return visibleCount;
+}
+
+bool Bvh::raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) const {
+    if (nodes.empty())
+        return false;
+    glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+    float nearest = maxDistance;
+    bool found = false;
+
+    uint32_t stack[StackSize];
+    int stackSize = 0;
+    float entry;
+    if (!intersectRay(nodes[0].min, nodes[0].max, origin, inverseDirection, nearest, entry))
+        return false;
+    stack[stackSize++] = 0;
+    while (stackSize > 0) {
+        const BvhNode& node = nodes[stack[--stackSize]];
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+                if (intersectRay(&leafBoxes[i].min.x, &leafBoxes[i].max.x, origin, inverseDirection, nearest, entry)) {
+                    nearest = entry;
+                    hit.box = boxIndices[i];
+                    hit.distance = entry;
+                    found = true;
+                }
+            }
+            continue;
+        }
+        // Visit the nearer child first, so the farther one is more often skipped
+        float leftEntry, rightEntry;
+        const BvhNode& leftNode = nodes[node.first];
+        const BvhNode& rightNode = nodes[node.first + 1];
+        bool leftHit = intersectRay(leftNode.min, leftNode.max, origin, inverseDirection, nearest, leftEntry);
+        bool rightHit = intersectRay(rightNode.min, rightNode.max, origin, inverseDirection, nearest, rightEntry);
+        if (leftHit && rightHit) {
+            bool leftFirst = leftEntry <= rightEntry;
+            stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+            stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+        } else if (leftHit) {
+            stack[stackSize++] = node.first;
+        } else if (rightHit) {
+            stack[stackSize++] = node.first + 1;
+        }
+    }
+    return found;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+// --- Bounding volume hierarchy ---
+// A binary tree of axis-aligned boxes over a static set of boxes, so culling and ray queries visit
+// the few subtrees that matter instead of every box. It is built top down with the surface area
+// heuristic over 16 bins per axis, and subtrees of more than ParallelBuildThreshold boxes are
+// built as jobs that other threads can pick up. Nodes live in one flat array, 32 bytes each,
+// with the two children of a node side by side; the leaves point into an array of box indices,
+// each subtree's boxes in one run. Boxes that move can be refit: the tree keeps its shape and only the bounds are redone,
+// which stays correct but slowly loses quality as the boxes drift.
+
+struct BvhBox {
+    glm::vec3 min;
+    glm::vec3 max;
+};
+// The box spanning center +/- halfSize, as from cubeBounds()
+inline BvhBox bvhBox(const glm::vec3& center, const glm::vec3& halfSize) { return { center - halfSize, center + halfSize }; }
+
+struct BvhNode {
+    float min[3];
+    uint32_t first; // Leaves: first entry in the box index array. Inner nodes: left child, the right one follows it.
+    float max[3];
+    uint32_t count; // Boxes in a leaf, 0 for inner nodes
+};
+static_assert(sizeof(BvhNode) == 32, "Two BVH nodes per cache line");
+
+struct BvhRayHit {
+    uint32_t box = 0;
+    float distance = 0.0f; // Along the ray, in units of the ray direction's length
+};
+
+class Bvh {
+public:
+    // Subtrees with more boxes than this are built as separate jobs
+    static const size_t ParallelBuildThreshold = 16 * 1024;
+
+    // Build over boxes, spread over jobs' threads if given
+    void build(const std::vector<BvhBox>& boxes, JobSystem* jobs = nullptr);
+    // Redo the bounds for boxes moved since the build. boxes must be the same count, in the same order.
+    void refit(const std::vector<BvhBox>& boxes);
+    void clear();
+
+    // Write the indices of the boxes that intersect frustum to visible, grouped by subtree rather than
+    // sorted, and return how many there are. visible must have room for boxCount() indices.
+    size_t cull(const Frustum& frustum, uint32_t* visible) const;
+
+    // The nearest box hit by the ray from origin along direction within maxDistance, if any
+    bool raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) const;
+
+    size_t boxCount() const { return boxIndices.size(); }
+    size_t nodeCount() const { return nodes.size(); }
+    const std::vector<BvhNode>& nodeArray() const { return nodes; }
+
+private:
+    std::vector<BvhNode> nodes;        // nodes[0] is the root
+    std::vector<uint32_t> boxIndices;  // Leaf ranges index this
+    std::vector<BvhBox> leafBoxes;     // The boxes in boxIndices order, for leaf tests without an indirection
+};
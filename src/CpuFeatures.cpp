@@ -0,0 +1,52 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace {
+    CpuFeatures detectCpuFeatures() {
+        CpuFeatures features;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int info[4];
+        __cpuid(info, 0);
+        int maxLeaf = info[0];
+        __cpuid(info, 1);
+        unsigned ecx1 = (unsigned)info[2], edx1 = (unsigned)info[3];
+        unsigned ebx7 = 0;
+        if (maxLeaf >= 7) {
+            __cpuidex(info, 7, 0);
+            ebx7 = (unsigned)info[1];
+        }
+        bool osSavesAvx = (ecx1 & (1u << 27)) && (_xgetbv(0) & 0x6) == 0x6;
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        unsigned eax, ebx, ecx, edx, ecx1 = 0, edx1 = 0, ebx7 = 0;
+        __get_cpuid(1, &eax, &ebx, &ecx1, &edx1);
+        if (__get_cpuid_max(0, nullptr) >= 7)
+            __cpuid_count(7, 0, eax, ebx7, ecx, edx);
+        bool osSavesAvx = false;
+        if (ecx1 & (1u << 27)) { // OSXSAVE, so xgetbv may be used
+            unsigned xcr0Low, xcr0High;
+            __asm__ volatile("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+            osSavesAvx = (xcr0Low & 0x6) == 0x6; // XMM and YMM state
+        }
+#else
+        unsigned ecx1 = 0, edx1 = 0, ebx7 = 0;
+        bool osSavesAvx = false;
+#endif
+        features.sse2 = (edx1 & (1u << 26)) != 0;
+        features.sse41 = (ecx1 & (1u << 19)) != 0;
+        features.avx = osSavesAvx && (ecx1 & (1u << 28)) != 0;
+        features.avx2 = features.avx && (ebx7 & (1u << 5)) != 0;
+        features.fma = features.avx && (ecx1 & (1u << 12)) != 0;
+        return features;
+    }
+}
+
+const CpuFeatures& cpuFeatures() {
+    static const CpuFeatures features = detectCpuFeatures();
+    return features;
+}
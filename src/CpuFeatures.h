@@ -0,0 +1,30 @@
+#pragma once
+
+// --- CPU features ---
+// The SIMD instruction sets the CPU and OS support, detected once at first use so hot loops can
+// pick a kernel at runtime. Everything is false on CPUs other than x86, which use scalar code.
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define CUBEY_X86 1
+#endif
+
+// GCC and Clang only emit SSE/AVX instructions in functions marked for them; MSVC always can
+#if defined(CUBEY_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CUBEY_TARGET_SSE2 __attribute__((target("sse2")))
+#define CUBEY_TARGET_AVX __attribute__((target("avx")))
+#define CUBEY_TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#else
+#define CUBEY_TARGET_SSE2
+#define CUBEY_TARGET_AVX
+#define CUBEY_TARGET_AVX2_FMA
+#endif
+
+struct CpuFeatures {
+    bool sse2 = false;  // Always true on x86-64
+    bool sse41 = false;
+    bool avx = false;   // Only when the OS also saves the AVX registers
+    bool avx2 = false;
+    bool fma = false;
+};
+
+const CpuFeatures& cpuFeatures();
@@ -0,0 +1,133 @@
+#include "CubeField.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GlState.h"
+
+namespace {
+    const float CubeSpacing = 2.0f; // Grid step, leaves about a cube of space between neighbours
+}
+
+bool CubeField::init(size_t count, int textureLayers, uint32_t seed) {
+    cubes.clear();
+    cubes.reserve(count);
+
+    // The smallest cubic grid that holds count cubes, filled row by row
+    size_t side = std::max<size_t>(1, (size_t)std::ceil(std::cbrt((double)count)));
+    while (side * side * side < count) ++side; // cbrt can round down on exact cubes
+    float center = (side - 1) * 0.5f;
+
+    std::mt19937 gen(seed); // Fixed seed, so runs with the same count are comparable
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+    std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+    std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 1.0f);
+    std::uniform_int_distribution<int> channel(64, 255);
+    std::uniform_int_distribution<int> layer(0, std::max(textureLayers, 1) - 1);
+
+    for (size_t i = 0; i < count; ++i) {
+        glm::vec3 cell((float)(i % side), (float)(i / side % side), (float)(i / (side * side)));
+        glm::vec3 position = (cell - glm::vec3(center)) * CubeSpacing + glm::vec3(jitter(gen), jitter(gen), jitter(gen));
+        glm::vec3 rotationAxis(axis(gen), axis(gen), axis(gen) + 0.01f); // Never the zero vector
+
+        CubeInstance cube;
+        cube.model = glm::translate(glm::mat4(1.0f), position);
+        cube.model = glm::rotate(cube.model, angle(gen), rotationAxis);
+        cube.model = glm::scale(cube.model, glm::vec3(scale(gen)));
+        cube.color[0] = (uint8_t)channel(gen);
+        cube.color[1] = (uint8_t)channel(gen);
+        cube.color[2] = (uint8_t)channel(gen);
+        cube.color[3] = 255;
+        cube.layer = (float)layer(gen);
+        cubes.push_back(cube);
+    }
+    // Grid half-diagonal, plus the half-diagonal of a jittered unit cube
+    boundingRadius = std::sqrt(3.0f) * (center * CubeSpacing + 0.3f + 0.5f);
+
+    glGenBuffers(1, &instanceBuffer);
+    glState.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, cubes.size() * sizeof(CubeInstance), cubes.data(), GL_DYNAMIC_DRAW);
+    glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "Not enough memory for " << count << " cube instances" << std::endl;
+        destroy();
+        return false;
+    }
+    uploadedCount = cubes.size();
+    uploadedAll = true;
+    return true;
+}
+
+void CubeField::destroy() {
+    glState.deleteBuffers(1, &instanceBuffer);
+    instanceBuffer = 0;
+    uploadedCount = 0;
+    uploadedAll = false;
+    cubes.clear();
+    cubes.shrink_to_fit();
+}
+
+void CubeField::uploadInstances(const uint32_t* indices, size_t indexCount) {
+    uploadedCount = indexCount;
+    uploadedAll = false;
+    if (indexCount == 0)
+        return;
+    // Gather straight into the mapped buffer. Invalidating it lets the driver hand out fresh
+    // storage instead of waiting for the previous frame's draws to finish reading.
+    glState.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    void* mapped = glMapBufferRange(GL_ARRAY_BUFFER, 0, indexCount * sizeof(CubeInstance),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        CubeInstance* target = static_cast<CubeInstance*>(mapped);
+        for (size_t i = 0; i < indexCount; ++i)
+            target[i] = cubes[indices[i]];
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    } else {
+        std::cerr << "Failed to map the cube instance buffer" << std::endl;
+        uploadedCount = 0;
+    }
+}
+
+void CubeField::uploadAll() {
+    if (uploadedAll)
+        return;
+    glState.bindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, cubes.size() * sizeof(CubeInstance), cubes.data());
+    uploadedCount = cubes.size();
+    uploadedAll = true;
+}
+
+void cubeBounds(const glm::mat4& model, glm::vec3& center, glm::vec3& halfSize) {
+    // Each axis of the box spans the absolute projections of the cube's three half edges
+    center = glm::vec3(model[3].x, model[3].y, model[3].z);
+    halfSize = glm::vec3(0.0f);
+    for (int column = 0; column < 3; ++column)
+        halfSize += glm::abs(glm::vec3(model[column].x, model[column].y, model[column].z)) * 0.5f;
+}
+
+void CubeField::bindAttributes() const {
+    bindCubeInstanceAttributes(instanceBuffer);
+}
+
+void bindCubeInstanceAttributes(GLuint buffer, GLuint divisor) {
+    glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+    for (GLuint column = 0; column < 4; ++column) {
+        GLuint location = CubeInstanceModelLocation + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance),
+                              (void*)(offsetof(CubeInstance, model) + column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, divisor);
+    }
+    glEnableVertexAttribArray(CubeInstanceColorLocation);
+    glVertexAttribPointer(CubeInstanceColorLocation, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CubeInstance), (void*)offsetof(CubeInstance, color));
+    glVertexAttribDivisor(CubeInstanceColorLocation, divisor);
+    glEnableVertexAttribArray(CubeInstanceLayerLocation);
+    glVertexAttribPointer(CubeInstanceLayerLocation, 1, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)offsetof(CubeInstance, layer));
+    glVertexAttribDivisor(CubeInstanceLayerLocation, divisor);
+    glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// --- Cube field ---
+// Many copies of the cube, drawn with one glDrawElementsInstanced call per cube material. The cube's
+// vertex and index buffers are shared by every copy, and what differs per copy (model matrix, tint,
+// texture array layer) lives in a per-instance vertex buffer stepped with glVertexAttribDivisor.
+
+struct CubeInstance {
+    glm::mat4 model;
+    uint8_t color[4]; // RGBA8 tint, normalized in the shader
+    float layer;      // Layer of the cube texture array shown on the textured face
+};
+static_assert(sizeof(CubeInstance) == 72, "CubeInstance must stay tightly packed");
+
+// Attribute locations of the per-instance data, after the cube's own position, color and UV
+const GLuint CubeInstanceModelLocation = 3; // A mat4 takes four locations, 3 to 6
+const GLuint CubeInstanceColorLocation = 7;
+const GLuint CubeInstanceLayerLocation = 8;
+
+// The axis-aligned box around the unit cube transformed by model
+void cubeBounds(const glm::mat4& model, glm::vec3& center, glm::vec3& halfSize);
+
+// Point the per-instance attributes of the bound VAO at CubeInstance records in buffer.
+// A divisor of 0 reads one record per vertex instead of per instance.
+void bindCubeInstanceAttributes(GLuint buffer, GLuint divisor = 1);
+
+class CubeField {
+public:
+    // Scatter count cubes over a grid centered on the origin and upload them.
+    // textureLayers is the number of layers instances pick their textured face from.
+    bool init(size_t count, int textureLayers, uint32_t seed = 1);
+    void destroy();
+
+    // Point the per-instance attributes of the bound VAO at the instance buffer
+    void bindAttributes() const;
+
+    // Replace the instance buffer with the listed instances, in order, so a draw of drawCount()
+    // instances covers only them. Used to draw the survivors of culling.
+    void uploadInstances(const uint32_t* indices, size_t indexCount);
+    // Put every instance back in the buffer, if a subset was uploaded last
+    void uploadAll();
+    // Instances in the buffer
+    size_t drawCount() const { return uploadedCount; }
+
+    size_t count() const { return cubes.size(); }
+    const std::vector<CubeInstance>& instances() const { return cubes; }
+    // Distance from the origin to the farthest cube corner, for placing the camera
+    float radius() const { return boundingRadius; }
+
+private:
+    GLuint instanceBuffer = 0;
+    size_t uploadedCount = 0;
+    bool uploadedAll = false;
+    std::vector<CubeInstance> cubes;
+    float boundingRadius = 0.0f;
+};
@@ -1,8 +1,17 @@
+#include <algorithm>
 #include <iostream>
 #include <map>
 #include <string>
 #include <format>   // Required for std::format
 #include <random>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <chrono>
+#include <cmath>
+#include <optional>
+#include <thread>
 
 // NEW: GLAD should be included BEFORE GLFW
 #include <glad/glad.h>
@@ -15,52 +24,329 @@
 #include "stb_truetype.h" // For font rendering
 #include "stb_image.h"  // For image loading
 
+#include "Bvh.h"
+#include "CubeField.h"
+#include "FontAtlasFile.h"
+#include "FrustumCuller.h"
+#include "GlState.h"
+#include "GlyphCache.h"
+#include "GpuCuller.h"
+#include "Hud.h"
+#include "JobSystem.h"
+#include "MappedFile.h"
+#include "OcclusionCuller.h"
+#include "ProgramBinaryCache.h"
+#include "RenderQueue.h"
+#include "RenderThread.h"
+#include "ShaderPermutations.h"
+#include "ShaderProgram.h"
+#include "TextLayoutCache.h"
+#include "TransformStore.h"
+#include "UniformRing.h"
+#include "VertexFormat.h"
+
 #define WIN_WIDTH 900
 #define WIN_HEIGHT 700
 
 // --- Global variables for font rendering ---
 GLuint textVAO, textVBO;
-GLuint textShaderProgram;
-stbtt_bakedchar charData[96];
-GLuint fontTexture;
 
-GLuint cubeTexture; // Texture for the cube
+// Draws of every pass go through one queue, flushed at the end of the pass. Layers, the top bits
+// of the sort keys, keep passes that share a flush in order.
+RenderQueue renderQueue;
+const unsigned SceneLayer = 0;
+const unsigned OverlayLayer = 1;
+
+// A text program with its uniforms resolved once at startup
+struct TextProgram {
+    ShaderProgram program;
+    Uniform<int> atlas;
+    Uniform<int> glyphMetrics;    // Instanced programs only
+    Uniform<glm::vec2> atlasSize; // Instanced programs only
+};
+TextProgram textProgram;
+std::vector<unsigned char> fontData; // The TTF file, kept alive for on-demand rasterization. Read when first needed.
+const char* const FontPath = "font.ttf"; // Make sure font.ttf is in your project or exe root
+GlyphCache glyphCache;    // Coverage glyphs rasterized at TextPixelHeight, created when F first switches to it
+GlyphCache sdfGlyphCache; // Distance field glyphs rasterized once at SdfPixelHeight and scaled to any size
+bool sdfText = true;      // Draw with sdfGlyphCache (F key)
+size_t glyphAtlasBudget = 0; // Of the coverage atlas. The SDF atlas gets a quarter of it.
+
+// Height in pixels of text drawn at scale 1.0
+const float TextPixelHeight = 48.0f;
+// Distance fields stay sharp when magnified, so a smaller rasterization serves every size
+const float SdfPixelHeight = 32.0f;
+
+// Two ways of getting glyphs to the GPU, switchable at runtime (T key) so they can be compared.
+enum class TextMode {
+    Batched,   // Six TextVertex per glyph built on the CPU (120 bytes per glyph)
+    Instanced  // One GlyphInstance per glyph, expanded into a quad by the vertex shader
+};
+TextMode textMode = TextMode::Batched;
+
+// --- Text batching state ---
+struct TextVertex {
+    float x, y, s, t;
+    uint8_t color[4]; // RGBA8, normalized in the shader
+};
+struct GlyphQuad {
+    TextVertex vertices[6];
+};
+static_assert(sizeof(GlyphQuad) == 120, "GlyphQuad must stay tightly packed");
+
+// Laid-out text persists in textVBO between frames; see TextLayoutCache.h
+TextLayoutCache<GlyphQuad> quadLayoutCache;
+GLsizeiptr textVBOCapacity = 0; // Current size of the textVBO data store in bytes
+
+// --- Instanced text state ---
+// Compact per-glyph record. The pen position is stored in quarter pixels.
+struct GlyphInstance {
+    int16_t x, y;
+    uint16_t glyph;    // Glyph cache slot, the index into the glyph metrics buffer
+    uint16_t scale;    // 8.8 fixed point, relative to the size the glyph was rasterized at
+    uint8_t color[4];  // RGBA8, normalized in the shader
+};
+static_assert(sizeof(GlyphInstance) == 12, "GlyphInstance must stay tightly packed");
+
+GLuint textInstancedVAO, textInstanceVBO;
+TextProgram textInstancedProgram;
+TextProgram textSdfProgram, textInstancedSdfProgram; // Same vertex stages with the SDF fragment shader
+TextLayoutCache<GlyphInstance> instanceLayoutCache;
+GLsizeiptr textInstanceVBOCapacity = 0;
+
+struct TextStats {
+    int glyphs = 0;
+    int drawCalls = 0;
+    int uploads = 0;
+    size_t bytesUploaded = 0;
+    int labelHits = 0;        // Labels drawn without any layout work
+    int labelPartialHits = 0; // Labels that only re-laid out a changed suffix
+    int labelMisses = 0;
+    int glyphsLaidOut = 0;
+};
+TextStats textStats; // Accumulated since the last resetTextStats()
 
-// --- Callback for GLFW window resize events ---
-void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
-    glViewport(0, 0, width, height);
-}
+GLuint cubeTexture; // Texture for the cube
+GLuint cubeTextureArray; // Turned copies of the cube texture, one layer per copy, for the cube field
+const int CubeTextureLayers = 4;
+// Where the cube field is frustum culled before it is drawn (C key)
+enum class CullMode {
+    Off,
+    Cpu, // FrustumCuller, the visible cubes are uploaded every frame
+    Bvh, // The same through the cube field's BVH
+    Gpu  // GpuCuller, the visible cubes never leave the GPU
+};
+bool gpuCullingReady = false; // Whether C can switch to CullMode::Gpu
+
+// What the keys switch. The main thread owns these and hands a copy to the render thread with every
+// frame, which sets textMode and sdfText from it before it draws any text.
+struct ViewSettings {
+    TextMode textMode = TextMode::Batched;
+    bool sdfText = true;
+    CullMode cullMode = CullMode::Cpu;
+    bool occlusionCulling = true; // Also drop the cubes hidden behind others, with CPU culling (O key)
+};
+ViewSettings viewSettings;
+
+ProgramBinaryCache programBinaryCache; // Linked programs from previous runs, see createShaderProgram()
+JobSystem jobSystem; // Worker threads for culling, transform updates and asset decoding
 
 // --- Callback for keyboard input ---
-void processInput(GLFWwindow *window, float& rotationX, float& rotationY) {
+void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
+
+    // Toggle between the batched and instanced text paths on key release
+    static bool textModeKeyDown = false;
+    bool textModeKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if (textModeKeyDown && !textModeKeyPressed)
+        viewSettings.textMode = (viewSettings.textMode == TextMode::Batched) ? TextMode::Instanced : TextMode::Batched;
+    textModeKeyDown = textModeKeyPressed;
+
+    // Toggle between the coverage and signed distance field glyph atlases
+    static bool sdfKeyDown = false;
+    bool sdfKeyPressed = glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS;
+    if (sdfKeyDown && !sdfKeyPressed)
+        viewSettings.sdfText = !viewSettings.sdfText;
+    sdfKeyDown = sdfKeyPressed;
+
+    static bool cullKeyDown = false;
+    bool cullKeyPressed = glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS;
+    if (cullKeyDown && !cullKeyPressed) {
+        CullMode& cullMode = viewSettings.cullMode;
+        if (cullMode == CullMode::Off)
+            cullMode = CullMode::Cpu;
+        else if (cullMode == CullMode::Cpu)
+            cullMode = CullMode::Bvh;
+        else if (cullMode == CullMode::Bvh && gpuCullingReady)
+            cullMode = CullMode::Gpu;
+        else
+            cullMode = CullMode::Off;
+    }
+    cullKeyDown = cullKeyPressed;
+
+    static bool occlusionKeyDown = false;
+    bool occlusionKeyPressed = glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS;
+    if (occlusionKeyDown && !occlusionKeyPressed)
+        viewSettings.occlusionCulling = !viewSettings.occlusionCulling;
+    occlusionKeyDown = occlusionKeyPressed;
+}
+
+// --- Simulation ---
+// The scene advances in fixed steps of SimulationStep seconds, however often it is drawn. Each frame
+// the main loop adds the time since the last frame to an accumulator and runs as many whole steps
+// as it holds. The leftover fraction of a step then picks a point between the last two states, and
+// that is what gets drawn, so motion stays smooth when frames and steps don't line up.
+const double SimulationStep = 1.0 / 60.0;
+const double MaxFrameTime = 0.25; // Longer gaps, such as a dragged window, are cut short rather than caught up on
+
+struct SimulationState {
+    float rotationX = 0.0f; // Degrees
+    float rotationY = 0.0f;
+};
+
+// Advance state by one step: the cube's own spin plus the arrow keys, in degrees per step
+void simulate(GLFWwindow* window, SimulationState& state, float rotationXSpeed, float rotationYSpeed) {
+    state.rotationX += rotationXSpeed;
+    state.rotationY += rotationYSpeed;
     if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS)
-        rotationX -= 2.0f;
+        state.rotationX -= 2.0f;
     if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS)
-        rotationX += 2.0f;
+        state.rotationX += 2.0f;
     if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS)
-        rotationY -= 2.0f;
+        state.rotationY -= 2.0f;
     if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS)
-        rotationY += 2.0f;
+        state.rotationY += 2.0f;
+    // A full turn is no turn at all, so wrapping doesn't move the cube
+    state.rotationX = std::remainder(state.rotationX, 360.0f);
+    state.rotationY = std::remainder(state.rotationY, 360.0f);
+}
+
+// The cube's orientation in state, about X and then Y in the cube's own frame
+glm::quat cubeRotation(const SimulationState& state) {
+    return glm::angleAxis(glm::radians(state.rotationX), glm::vec3(1.0f, 0.0f, 0.0f)) *
+           glm::angleAxis(glm::radians(state.rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
 }
 
+// --- Uniform blocks ---
+// Per-frame data is uploaded once and shared by every program, per-object data once per object.
+// These mirror the std140 blocks declared in the shaders below.
+const GLuint FrameDataBinding = 0;
+const GLuint ObjectDataBinding = 1;
+
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::mat4 ortho;
+    glm::vec4 viewport;
+    glm::vec4 time;
+};
+static_assert(sizeof(FrameData) == 288, "FrameData must match the std140 layout of the FrameData block");
+
+struct ObjectData {
+    glm::mat4 model;
+};
+static_assert(sizeof(ObjectData) == 64, "ObjectData must match the std140 layout of the ObjectData block");
+
+UniformRing uniformRing;
+// The firstTriangle uniform of each FEEDBACK cube variant, by feature mask, resolved when the variant is built
+Uniform<int> cubeFirstTriangle[1 << ShaderFeatureCount];
+
 // --- Shader Sources ---
+// The cube shaders are compiled per combination of TEXTURED, VERTEX_COLOR, INSTANCED, PROCEDURAL and FEEDBACK (see ShaderPermutations.h)
 const char* vertexShaderSource = R"(
     #version 330 core
+#ifdef PROCEDURAL
+    // The 36 vertices of the cube in the order of its index buffer: the five plain faces, then the
+    // textured front face. Vertex i is corner quadCorners[i % 6] of face i / 6.
+    const vec3 faceCorners[24] = vec3[24](
+        vec3(-0.5, -0.5, -0.5), vec3( 0.5, -0.5, -0.5), vec3( 0.5,  0.5, -0.5), vec3(-0.5,  0.5, -0.5), // Back
+        vec3(-0.5,  0.5,  0.5), vec3(-0.5,  0.5, -0.5), vec3(-0.5, -0.5, -0.5), vec3(-0.5, -0.5,  0.5), // Left
+        vec3( 0.5,  0.5,  0.5), vec3( 0.5,  0.5, -0.5), vec3( 0.5, -0.5, -0.5), vec3( 0.5, -0.5,  0.5), // Right
+        vec3(-0.5, -0.5, -0.5), vec3( 0.5, -0.5, -0.5), vec3( 0.5, -0.5,  0.5), vec3(-0.5, -0.5,  0.5), // Bottom
+        vec3(-0.5,  0.5, -0.5), vec3( 0.5,  0.5, -0.5), vec3( 0.5,  0.5,  0.5), vec3(-0.5,  0.5,  0.5), // Top
+        vec3(-0.5, -0.5,  0.5), vec3( 0.5, -0.5,  0.5), vec3( 0.5,  0.5,  0.5), vec3(-0.5,  0.5,  0.5)  // Front
+    );
+    const vec3 faceColors[6] = vec3[6](
+        vec3(1.0, 0.0, 0.0), vec3(0.0, 0.0, 1.0), vec3(0.0, 1.0, 0.0),
+        vec3(1.0, 0.5, 0.0), vec3(0.5, 0.5, 1.0), vec3(1.0, 1.0, 1.0)
+    );
+    const vec2 quadTexCoords[4] = vec2[4](vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+    const int quadCorners[6] = int[6](0, 1, 2, 2, 3, 0);
+    const int TexturedFace = 5;
+#ifdef FEEDBACK
+    uniform int firstTriangle; // Cube triangle drawn by instance 0
+#endif
+#else
     layout (location = 0) in vec3 aPos;
+#ifdef VERTEX_COLOR
     layout (location = 1) in vec3 aColor;
-    layout (location = 2) in vec2 aTexCoord; // New texture coordinate attribute
-
+#endif
+#ifdef TEXTURED
+    layout (location = 2) in vec2 aTexCoord;
+#endif
+#endif
+#ifdef VERTEX_COLOR
     out vec3 ourColor;
+#endif
+#ifdef TEXTURED
     out vec2 TexCoord; // Pass texture coordinate to fragment shader
+#endif
+#ifdef INSTANCED
+    layout (location = 3) in mat4 aModel; // Per instance, takes locations 3 to 6
+    layout (location = 7) in vec4 aInstanceColor; // Per instance tint, normalized RGBA8
+    layout (location = 8) in float aLayer;        // Per instance texture array layer
+    out vec4 instanceColor;
+#ifdef TEXTURED
+    flat out float textureLayer;
+#endif
+#endif
 
-    uniform mat4 mvp;
+    layout (std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        mat4 viewProjection;
+        mat4 ortho;     // Framebuffer pixels, y down
+        vec4 viewport;  // Width, height, 1 / width, 1 / height
+        vec4 time;      // Seconds since start, seconds since the previous frame
+    } frame;
+    layout (std140) uniform ObjectData {
+        mat4 model;
+    } objectData;
 
     void main() {
-        gl_Position = mvp * vec4(aPos, 1.0);
+#ifdef PROCEDURAL
+#ifdef FEEDBACK
+        // GPU culling captured every visible cube three times, once per corner of a triangle,
+        // and each instance of the draw is one triangle of the cube
+        int cubeVertex = (firstTriangle + gl_InstanceID) * 3 + gl_VertexID % 3;
+#else
+        int cubeVertex = gl_VertexID;
+#endif
+        int face = cubeVertex / 6;
+        int corner = quadCorners[cubeVertex % 6];
+        vec3 aPos = faceCorners[face * 4 + corner];
+        vec3 aColor = faceColors[face];
+        vec2 aTexCoord = face == TexturedFace ? quadTexCoords[corner] : vec2(0.0);
+#endif
+#ifdef INSTANCED
+        // The object's model matrix places the whole set of instances
+        mat4 model = objectData.model * aModel;
+        instanceColor = aInstanceColor;
+#else
+        mat4 model = objectData.model;
+#endif
+        gl_Position = frame.viewProjection * model * vec4(aPos, 1.0);
+#ifdef VERTEX_COLOR
         ourColor = aColor;
+#endif
+#ifdef TEXTURED
         TexCoord = aTexCoord;
+#ifdef INSTANCED
+        textureLayer = aLayer;
+#endif
+#endif
     }
 )";
 
@@ -68,14 +354,39 @@ const char* fragmentShaderSource = R"(
     #version 330 core
     out vec4 FragColor;
 
+#ifdef VERTEX_COLOR
     in vec3 ourColor;
+#endif
+#ifdef INSTANCED
+    in vec4 instanceColor;
+#endif
+#ifdef TEXTURED
     in vec2 TexCoord; // Receive texture coordinate from vertex shader
-
+#ifdef INSTANCED
+    flat in float textureLayer;
+    uniform sampler2DArray ourTexture; // Each instance picks a layer
+#else
     uniform sampler2D ourTexture; // The texture sampler
+#endif
+#endif
 
     void main() {
+        vec4 color = vec4(1.0);
+#ifdef VERTEX_COLOR
+        color.rgb = ourColor;
+#endif
+#ifdef INSTANCED
+        color *= instanceColor;
+#endif
+#ifdef TEXTURED
         // Mix the texture color with the vertex color
-        FragColor = texture(ourTexture, TexCoord) * vec4(ourColor, 1.0);
+#ifdef INSTANCED
+        color *= texture(ourTexture, vec3(TexCoord, textureLayer));
+#else
+        color *= texture(ourTexture, TexCoord);
+#endif
+#endif
+        FragColor = color;
     }
 )";
 
@@ -83,36 +394,149 @@ const char* fragmentShaderSource = R"(
 const char* textVertexShaderSource = R"(
     #version 330 core
     layout (location = 0) in vec4 vertex; // vec2 pos, vec2 tex
+    layout (location = 1) in vec4 aColor; // Normalized RGBA8
     out vec2 TexCoords;
+    out vec4 GlyphColor;
 
-    uniform mat4 projection;
+    layout (std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        mat4 viewProjection;
+        mat4 ortho;     // Framebuffer pixels, y down
+        vec4 viewport;  // Width, height, 1 / width, 1 / height
+        vec4 time;      // Seconds since start, seconds since the previous frame
+    } frame;
 
     void main() {
-        gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
+        gl_Position = frame.ortho * vec4(vertex.xy, 0.0, 1.0);
         TexCoords = vertex.zw;
+        GlyphColor = aColor;
     }
 )";
 const char* textFragmentShaderSource = R"(
     #version 330 core
     in vec2 TexCoords;
+    in vec4 GlyphColor;
     out vec4 color;
 
     uniform sampler2D text;
-    uniform vec3 textColor;
 
     void main() {
         // The font texture is single-channel (alpha). We use its value
         // to set the alpha of our output color.
         float alpha = texture(text, TexCoords).r;
-        color = vec4(textColor, alpha);
+        color = vec4(GlyphColor.rgb, GlyphColor.a * alpha);
+    }
+)";
+const char* textSdfFragmentShaderSource = R"(
+    #version 330 core
+    in vec2 TexCoords;
+    in vec4 GlyphColor;
+    out vec4 color;
+
+    uniform sampler2D text;
+
+    void main() {
+        // The atlas stores distance to the outline, with 0.5 on the edge.
+        // fwidth keeps the anti-aliased edge about one screen pixel wide at any scale.
+        float distance = texture(text, TexCoords).r;
+        float edgeWidth = fwidth(distance);
+        float alpha = smoothstep(0.5 - edgeWidth, 0.5 + edgeWidth, distance);
+        color = vec4(GlyphColor.rgb, GlyphColor.a * alpha);
+    }
+)";
+
+// Instanced text: each instance is one glyph, and gl_VertexID picks the corner of its quad.
+// Glyph rectangles and offsets come from the glyph cache's metrics texture buffer.
+// It shares the fragment shaders above.
+const char* textInstancedVertexShaderSource = R"(
+    #version 330 core
+    layout (location = 0) in vec2 aPos;   // Pen position in quarter pixels
+    layout (location = 1) in uint aGlyph; // Glyph index
+    layout (location = 2) in vec4 aColor; // Normalized RGBA8
+    layout (location = 3) in float aScale; // 8.8 fixed point
+    out vec2 TexCoords;
+    out vec4 GlyphColor;
+
+    layout (std140) uniform FrameData {
+        mat4 view;
+        mat4 projection;
+        mat4 viewProjection;
+        mat4 ortho;     // Framebuffer pixels, y down
+        vec4 viewport;  // Width, height, 1 / width, 1 / height
+        vec4 time;      // Seconds since start, seconds since the previous frame
+    } frame;
+    uniform samplerBuffer glyphMetrics; // Texel 2*i: atlas rect (x0, y0, x1, y1), texel 2*i+1: offset (xoff, yoff)
+    uniform vec2 atlasSize;
+
+    const vec2 corners[6] = vec2[6](
+        vec2(0.0, 0.0), vec2(0.0, 1.0), vec2(1.0, 1.0),
+        vec2(0.0, 0.0), vec2(1.0, 1.0), vec2(1.0, 0.0)
+    );
+
+    void main() {
+        vec4 rect = texelFetch(glyphMetrics, int(aGlyph) * 2);
+        vec4 offset = texelFetch(glyphMetrics, int(aGlyph) * 2 + 1);
+        vec2 corner = corners[gl_VertexID];
+
+        // Same pixel snapping as stbtt_GetBakedQuad
+        float scale = aScale / 256.0;
+        vec2 origin = floor(aPos * 0.25 + offset.xy * scale + 0.5);
+        vec2 pos = origin + corner * (rect.zw - rect.xy) * scale;
+
+        gl_Position = frame.ortho * vec4(pos, 0.0, 1.0);
+        TexCoords = mix(rect.xy, rect.zw, corner) / atlasSize;
+        GlyphColor = aColor;
+    }
+)";
+
+// HUD composite: one triangle covering the screen, copying the HUD texture pixel for pixel
+const char* hudVertexShaderSource = R"(
+    #version 330 core
+    void main() {
+        vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+        gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+    }
+)";
+
+const char* hudFragmentShaderSource = R"(
+    #version 330 core
+    out vec4 FragColor;
+
+    uniform sampler2D hud; // Premultiplied alpha
+
+    void main() {
+        FragColor = texelFetch(hud, ivec2(gl_FragCoord.xy), 0);
     }
 )";
 
 // --- Helper function to compile shaders ---
-GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource) {
+// Insert defines (lines of "#define NAME") right after the #version line, which must come first
+std::string insertDefines(const char* source, const std::string& defines) {
+    std::string result = source;
+    if (defines.empty())
+        return result;
+    size_t version = result.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : result.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return defines + result;
+    return result.insert(lineEnd + 1, defines);
+}
+
+GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource, const std::string& defines = "") {
+    // --- 0. Reuse the binary linked by a previous run ---
+    uint64_t cacheKey = programBinaryCache.makeKey(vertexSource, fragmentSource, defines);
+    if (GLuint cachedProgram = programBinaryCache.load(cacheKey))
+        return cachedProgram;
+
+    std::string vertexCode = insertDefines(vertexSource, defines);
+    std::string fragmentCode = insertDefines(fragmentSource, defines);
+    const char* vertexCodePtr = vertexCode.c_str();
+    const char* fragmentCodePtr = fragmentCode.c_str();
+
     // --- 1. Compile Vertex Shader ---
     GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, NULL);
+    glShaderSource(vertexShader, 1, &vertexCodePtr, NULL);
     glCompileShader(vertexShader);
 
     // Check for vertex shader compile errors
@@ -126,7 +550,7 @@ GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource)
 
     // --- 2. Compile Fragment Shader ---
     GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, NULL);
+    glShaderSource(fragmentShader, 1, &fragmentCodePtr, NULL);
     glCompileShader(fragmentShader);
 
     // Check for fragment shader compile errors
@@ -140,6 +564,7 @@ GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource)
     GLuint shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
+    programBinaryCache.prepareForLink(shaderProgram);
     glLinkProgram(shaderProgram);
 
     // Check for linking errors
@@ -147,6 +572,8 @@ GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource)
     if (!success) {
         glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
         std::cerr << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+    } else {
+        programBinaryCache.store(cacheKey, shaderProgram);
     }
 
     // --- 4. Clean Up ---
@@ -158,81 +585,332 @@ GLuint createShaderProgram(const char* vertexSource, const char* fragmentSource)
 }
 
 // --- Text Rendering Function Implementations ---
-void loadFont(const char* fontPath) {
+// The glyph cache text is currently drawn from
+GlyphCache& activeGlyphCache() {
+    return sdfText ? sdfGlyphCache : glyphCache;
+}
+
+// Point the instanced text program of a glyph cache at the size of its atlas
+void setAtlasSize(bool sdf) {
+    TextProgram& text = sdf ? textInstancedSdfProgram : textInstancedProgram;
+    const GlyphCache& cache = sdf ? sdfGlyphCache : glyphCache;
+    text.program.use();
+    text.atlasSize.set(glm::vec2((float)cache.atlasWidth(), (float)cache.atlasHeight()));
+}
+
+bool loadFont(const char* fontPath) {
     // Read font file
     FILE* fontFile = fopen(fontPath, "rb");
+    if (!fontFile) {
+        std::cerr << "Failed to open font: " << fontPath << std::endl;
+        return false;
+    }
     fseek(fontFile, 0, SEEK_END);
     long size = ftell(fontFile);
     fseek(fontFile, 0, SEEK_SET);
-    unsigned char* ttfBuffer = new unsigned char[size];
-    fread(ttfBuffer, 1, size, fontFile);
+    fontData.resize(size);
+    fread(fontData.data(), 1, size, fontFile);
     fclose(fontFile);
+    return true;
+}
 
-    // Bake font bitmap
-    const int FONT_ATLAS_WIDTH = 512;
-    const int FONT_ATLAS_HEIGHT = 512;
-    unsigned char fontBitmap[FONT_ATLAS_WIDTH * FONT_ATLAS_HEIGHT];
-    stbtt_BakeFontBitmap(ttfBuffer, 0, 48.0f, fontBitmap, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 32, 96, charData); // ASCII 32-127
-    delete[] ttfBuffer;
-
-    // Create OpenGL texture for the font atlas
-    glGenTextures(1, &fontTexture);
-    glBindTexture(GL_TEXTURE_2D, fontTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, FONT_ATLAS_WIDTH, FONT_ATLAS_HEIGHT, 0, GL_RED, GL_UNSIGNED_BYTE, fontBitmap);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+// Create the glyph cache of the coverage or the SDF atlas from font.ttf, unless it exists. Only the
+// cache text is drawn with is created at startup, so the other atlas takes no memory until F
+// switches to it, and with a cooked atlas the TTF isn't even read until then. Returns false if the
+// cache can't be created, now or on an earlier try.
+bool initGlyphCache(bool sdf) {
+    GlyphCache& cache = sdf ? sdfGlyphCache : glyphCache;
+    if (cache.texture() != 0)
+        return true;
+    static bool failed[2] = { false, false };
+    if (failed[sdf])
+        return false;
+    if (fontData.empty() && !loadFont(FontPath)) {
+        failed[sdf] = true;
+        return false;
+    }
+    // Glyphs are rasterized into the atlas the first time they are drawn
+    bool created = sdf ? cache.init(fontData.data(), SdfPixelHeight, glyphAtlasBudget / 4, GlyphRaster::SignedDistance)
+                       : cache.init(fontData.data(), TextPixelHeight, glyphAtlasBudget);
+    failed[sdf] = !created;
+    if (created)
+        setAtlasSize(sdf);
+    return created;
+}
 
-    // Configure VAO/VBO for texture quads
+// font.ttf for a cooked glyph cache, read the first time text needs a glyph the atlas lacks
+const unsigned char* loadFallbackFont() {
+    if (fontData.empty() && !loadFont(FontPath))
+        return nullptr;
+    return fontData.data();
+}
+
+// Load a font atlas cooked by FontCooker into the glyph cache of its raster mode.
+// The file is mapped and uploaded as is, and no TTF is parsed until a codepoint the file lacks is
+// drawn; that one is rasterized from font.ttf into the atlas rows the cooked glyphs leave free.
+bool loadCookedFont(const char* atlasPath) {
+    MappedFile atlasFile;
+    if (!atlasFile.open(atlasPath))
+        return false;
+    const FontAtlasHeader* header = validateFontAtlas(atlasFile.data(), atlasFile.size());
+    if (!header) {
+        std::cerr << "Not a font atlas file: " << atlasPath << std::endl;
+        return false;
+    }
+    sdfText = header->raster == (uint32_t)GlyphRaster::SignedDistance;
+    if (!activeGlyphCache().initCooked(atlasFile.data(), atlasFile.size(), loadFallbackFont))
+        return false;
+    setAtlasSize(sdfText);
+    return true;
+}
+
+// Create the text vertex buffers and bind the glyph caches to the instanced text programs
+void setupTextRendering() {
+    // Configure VAO/VBO for texture quads.
+    // The buffer starts empty and is grown by flushText() to fit the laid-out text.
     glGenVertexArrays(1, &textVAO);
     glGenBuffers(1, &textVBO);
-    glBindVertexArray(textVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, NULL, GL_DYNAMIC_DRAW);
+    glState.bindVertexArray(textVAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, textVBO);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(TextVertex), (void*)offsetof(TextVertex, x));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(TextVertex), (void*)offsetof(TextVertex, color));
+    glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+    glState.bindVertexArray(0);
+
+    // Configure VAO/VBO for glyph instances. There is no per-vertex data at all.
+    glGenVertexArrays(1, &textInstancedVAO);
+    glGenBuffers(1, &textInstanceVBO);
+    glState.bindVertexArray(textInstancedVAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, textInstanceVBO);
     glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+    glVertexAttribPointer(0, 2, GL_SHORT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, x));
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribIPointer(1, 1, GL_UNSIGNED_SHORT, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, glyph));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, color));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(GlyphInstance), (void*)offsetof(GlyphInstance, scale));
+    glVertexAttribDivisor(3, 1);
+    glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+    glState.bindVertexArray(0);
+
+    // The atlas sizes are set as the glyph caches are created
+    for (TextProgram* text : { &textInstancedProgram, &textInstancedSdfProgram }) {
+        text->program.use();
+        text->glyphMetrics.set(1);
+    }
+    glState.useProgram(0);
 }
 
-// Render text at position (x, y) with given scale
-void renderText(const std::string& text, float x, float y, float scale) {
-    glUseProgram(textShaderProgram);
-    glUniform3f(glGetUniformLocation(textShaderProgram, "textColor"), 1.0f, 1.0f, 1.0f); // White text
-    glActiveTexture(GL_TEXTURE0);
-    glBindVertexArray(textVAO);
-    glBindTexture(GL_TEXTURE_2D, fontTexture);
-
-    // Iterate through all characters
-    for (char c : text) {
-        if (c >= 32 && c < 128) {
-            stbtt_aligned_quad q;
-            stbtt_GetBakedQuad(charData, 512, 512, c - 32, &x, &y, &q, 1);
-
-            float vertices[6][4] = {
-                { q.x0, q.y0, q.s0, q.t0 },
-                { q.x0, q.y1, q.s0, q.t1 },
-                { q.x1, q.y1, q.s1, q.t1 },
-
-                { q.x0, q.y0, q.s0, q.t0 },
-                { q.x1, q.y1, q.s1, q.t1 },
-                { q.x1, q.y0, q.s1, q.t0 }
-            };
-
-            // Render glyph texture over quad
-            glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
-            glBindBuffer(GL_ARRAY_BUFFER, 0);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
+// Compile a text program and resolve its uniforms. The atlas is always on texture unit 0.
+void createTextProgram(TextProgram& text, const char* vertexSource, const char* fragmentSource, bool instanced) {
+    text.program.create(createShaderProgram(vertexSource, fragmentSource));
+    text.program.bindUniformBlock("FrameData", FrameDataBinding);
+    text.atlas = text.program.uniform<int>("text");
+    if (instanced) {
+        text.glyphMetrics = text.program.uniform<int>("glyphMetrics");
+        text.atlasSize = text.program.uniform<glm::vec2>("atlasSize");
+    }
+    text.program.use();
+    text.atlas.set(0);
+}
+
+// Fill the record of one glyph with the pen at (x, y)
+void makeGlyphRecord(GlyphQuad& quad, const CachedGlyph& glyph, const GlyphCache& cache,
+                     float x, float y, float glyphScale, const uint8_t color[4]) {
+    // Same pixel snapping as stbtt_GetBakedQuad
+    float x0 = std::floor(x + glyph.xoff * glyphScale + 0.5f);
+    float y0 = std::floor(y + glyph.yoff * glyphScale + 0.5f);
+    float x1 = x0 + (glyph.x1 - glyph.x0) * glyphScale;
+    float y1 = y0 + (glyph.y1 - glyph.y0) * glyphScale;
+    float s0 = glyph.x0 / (float)cache.atlasWidth(), t0 = glyph.y0 / (float)cache.atlasHeight();
+    float s1 = glyph.x1 / (float)cache.atlasWidth(), t1 = glyph.y1 / (float)cache.atlasHeight();
+
+    const float corners[6][4] = {
+        { x0, y0, s0, t0 },
+        { x0, y1, s0, t1 },
+        { x1, y1, s1, t1 },
+
+        { x0, y0, s0, t0 },
+        { x1, y1, s1, t1 },
+        { x1, y0, s1, t0 }
+    };
+    for (int v = 0; v < 6; ++v) {
+        TextVertex& vertex = quad.vertices[v];
+        vertex.x = corners[v][0];
+        vertex.y = corners[v][1];
+        vertex.s = corners[v][2];
+        vertex.t = corners[v][3];
+        std::copy(color, color + 4, vertex.color);
+    }
+}
+
+// Instances name the glyph's slot and the shader reads its rectangle, so the cache goes unused
+void makeGlyphRecord(GlyphInstance& instance, const CachedGlyph& glyph, const GlyphCache&,
+                     float x, float y, float glyphScale, const uint8_t color[4]) {
+    instance.x = (int16_t)glm::clamp(std::round(x * 4.0f), -32768.0f, 32767.0f);
+    instance.y = (int16_t)glm::clamp(std::round(y * 4.0f), -32768.0f, 32767.0f);
+    instance.glyph = glyph.slot;
+    instance.scale = (uint16_t)glm::clamp(std::round(glyphScale * 256.0f), 1.0f, 65535.0f);
+    std::copy(color, color + 4, instance.color);
+}
+
+// Submit a label to a layout cache, laying out only what changed since last frame.
+// Returns the area its glyphs cover.
+template <typename Record>
+HudRect queueLaidOutText(TextLayoutCache<Record>& layoutCache, const TextLayoutKey& key, const std::string& text) {
+    GlyphCache& cache = *key.cache;
+    // Glyph metrics are in the pixels of the cache's rasterization size
+    const float glyphScale = key.scale * TextPixelHeight / cache.pixelHeight();
+    const uint8_t color[4] = { (uint8_t)key.color, (uint8_t)(key.color >> 8), (uint8_t)(key.color >> 16), (uint8_t)(key.color >> 24) };
+
+    const auto& labelGlyphs = layoutCache.submit(key, text, [&](const std::string& text, size_t start, float penX, std::vector<LaidOutGlyph<Record>>& glyphs) {
+        size_t i = start;
+        while (i < text.size()) {
+            uint32_t byteOffset = (uint32_t)i;
+            uint32_t codepoint = nextCodepoint(text, i);
+            const CachedGlyph* glyph = cache.get(codepoint);
+            if (!glyph)
+                continue; // The atlas is full of glyphs used this frame
+
+            LaidOutGlyph<Record> laidOut;
+            makeGlyphRecord(laidOut.record, *glyph, cache, penX, key.y, glyphScale, color);
+            laidOut.byteOffset = byteOffset;
+            laidOut.penX = penX;
+            laidOut.glyph = glyph;
+            glyphs.push_back(laidOut);
+            penX += glyph->xadvance * glyphScale;
         }
+        return penX;
+    });
+
+    // One pixel of margin for the pixel snapping and linear filtering of the quads
+    HudRect bounds;
+    for (const LaidOutGlyph<Record>& g : labelGlyphs) {
+        HudRect quad;
+        quad.x0 = g.penX + g.glyph->xoff * glyphScale - 1.0f;
+        quad.y0 = key.y + g.glyph->yoff * glyphScale - 1.0f;
+        quad.x1 = quad.x0 + (g.glyph->x1 - g.glyph->x0) * glyphScale + 2.0f;
+        quad.y1 = quad.y0 + (g.glyph->y1 - g.glyph->y0) * glyphScale + 2.0f;
+        bounds.add(quad);
+    }
+    return bounds;
+}
+
+// Call once per frame before queueing any text
+void beginTextFrame() {
+    glyphCache.beginFrame();
+    sdfGlyphCache.beginFrame();
+    quadLayoutCache.beginFrame();
+    instanceLayoutCache.beginFrame();
+}
+
+// Queue text at position (x, y) with given scale and color for this frame, and return the area it covers.
+// A label that is queued again next frame with the same position, scale and color reuses its layout.
+HudRect queueText(const std::string& text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f)) {
+    TextLayoutKey key;
+    key.cache = &activeGlyphCache();
+    key.x = x;
+    key.y = y;
+    key.scale = scale;
+    key.color = (uint32_t)(glm::clamp(color.r, 0.0f, 1.0f) * 255.0f + 0.5f)
+              | (uint32_t)(glm::clamp(color.g, 0.0f, 1.0f) * 255.0f + 0.5f) << 8
+              | (uint32_t)(glm::clamp(color.b, 0.0f, 1.0f) * 255.0f + 0.5f) << 16
+              | 0xFF000000u;
+
+    if (textMode == TextMode::Instanced)
+        return queueLaidOutText(instanceLayoutCache, key, text);
+    return queueLaidOutText(quadLayoutCache, key, text);
+}
+
+void addLayoutStats(const TextLayoutStats& layout) {
+    textStats.glyphs += layout.glyphsDrawn;
+    textStats.uploads += layout.uploads;
+    textStats.bytesUploaded += layout.bytesUploaded;
+    textStats.labelHits += layout.hits;
+    textStats.labelPartialHits += layout.partialHits;
+    textStats.labelMisses += layout.misses;
+    textStats.glyphsLaidOut += layout.glyphsLaidOut;
+}
+
+// Upload what changed in the text queued this frame and draw all of it with one call.
+// Call once per frame, after the last queueText(). Labels not queued this frame are dropped.
+void flushText() {
+    GlyphCache& cache = activeGlyphCache();
+    cache.flushUploads(); // Rasterized since the last flush
+
+    size_t quads = quadLayoutCache.flush(textVBO, textVBOCapacity);
+    if (quads > 0) {
+        DrawItem item;
+        item.program = (sdfText ? textSdfProgram : textProgram).program.id();
+        item.vertexArray = textVAO;
+        item.texture = cache.texture();
+        item.count = static_cast<GLsizei>(quads * 6);
+        renderQueue.submit(RenderQueue::sortKey(OverlayLayer, item.program, item.texture, item.vertexArray, 0.0f), item);
+        textStats.drawCalls++;
+    }
+
+    size_t instances = instanceLayoutCache.flush(textInstanceVBO, textInstanceVBOCapacity);
+    if (instances > 0) {
+        // The glyph metrics sit on unit 1, which the queue doesn't manage
+        glState.activeTexture(GL_TEXTURE1);
+        glState.bindTexture(GL_TEXTURE_BUFFER, cache.metricsTexture());
+        DrawItem item;
+        item.program = (sdfText ? textInstancedSdfProgram : textInstancedProgram).program.id();
+        item.vertexArray = textInstancedVAO;
+        item.texture = cache.texture();
+        item.kind = DrawKind::ArraysInstanced;
+        item.count = 6;
+        item.instances = static_cast<GLsizei>(instances);
+        renderQueue.submit(RenderQueue::sortKey(OverlayLayer, item.program, item.texture, item.vertexArray, 0.0f), item);
+        textStats.drawCalls++;
     }
-    glBindVertexArray(0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glState.activeTexture(GL_TEXTURE0);
+    renderQueue.flush();
+
+    addLayoutStats(quadLayoutCache.resetStats());
+    addLayoutStats(instanceLayoutCache.resetStats());
+    // What is left bound stays in glState, so the next frame's binds of the same objects are dropped
+}
+
+// Return the text counters gathered since the previous call and start counting again
+TextStats resetTextStats() {
+    TextStats stats = textStats;
+    textStats = TextStats();
+    return stats;
+}
+
+// An image decoded to RGBA8, bottom row first as OpenGL expects. Decoding needs no GL context, so
+// it can run as a job while the main thread sets up the window.
+struct DecodedImage {
+    int width = 0, height = 0;
+    std::vector<uint32_t> texels; // One RGBA8 texel per element, empty if the file could not be read
+};
+
+DecodedImage decodeImage(const char* path) {
+    DecodedImage image;
+    int nrChannels;
+    stbi_set_flip_vertically_on_load_thread(true); // Flip the image vertically to match OpenGL's coordinate system
+    unsigned char *data = stbi_load(path, &image.width, &image.height, &nrChannels, 4);
+    if (!data) {
+        std::cerr << "Failed to load texture: " << path << std::endl;
+        return image;
+    }
+    image.texels.resize((size_t)image.width * image.height);
+    std::memcpy(image.texels.data(), data, image.texels.size() * sizeof(uint32_t));
+    stbi_image_free(data); // Free the image memory
+    return image;
 }
 
 //  --- Texture Loading Function ---
-void loadTexture(const char* path, GLuint& textureID) {
+void loadTexture(const DecodedImage& image, GLuint& textureID) {
     glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_2D, textureID);
+    glState.bindTexture(GL_TEXTURE_2D, textureID);
 
     // Set texture wrapping/filtering options
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -240,22 +918,252 @@ void loadTexture(const char* path, GLuint& textureID) {
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    // Load image data using stb_image
-    int width, height, nrChannels;
-    stbi_set_flip_vertically_on_load(true); // Flip the image vertically to match OpenGL's coordinate system
-    unsigned char *data = stbi_load(path, &width, &height, &nrChannels, 0);
-    if (data) {
-        GLenum format = (nrChannels == 4) ? GL_RGBA : GL_RGB;
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+    if (!image.texels.empty()) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.texels.data());
         glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cerr << "Failed to load texture: " << path << std::endl;
     }
-    stbi_image_free(data); // Free the image memory
 }
 
+// Load an image into a 2D texture array of layers copies, each turned another quarter turn, so
+// instances that pick different layers can be told apart. Non-square images are not turned.
+void loadTextureArray(const DecodedImage& image, int layers, GLuint& textureID) {
+    glGenTextures(1, &textureID);
+    glState.bindTexture(GL_TEXTURE_2D_ARRAY, textureID);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if (image.texels.empty()) {
+        glState.bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        return;
+    }
+    const int width = image.width, height = image.height;
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    const uint32_t* source = image.texels.data();
+    std::vector<uint32_t> layer((size_t)width * height); // Reused for every turned copy
+    for (int l = 0; l < layers; ++l) {
+        int turns = width == height ? l % 4 : 0;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                int sx = x, sy = y;
+                for (int t = 0; t < turns; ++t) { int tmp = sx; sx = width - 1 - sy; sy = tmp; }
+                layer[(size_t)y * width + x] = source[(size_t)sy * width + sx];
+            }
+        }
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, l, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glState.bindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
+
+// --- Cube vertex format ---
+// 16 bytes per vertex instead of 8 floats: half float position, normalized RGBA8 color and
+// UNORM16 texture coordinates. The positions (+-0.5) and texture coordinates (0 or 1) are exact.
+struct CubeVertex {
+    HalfFloat position[4]; // x, y, z and padding
+    uint8_t color[4];      // r, g, b and padding
+    uint16_t texCoord[2];
+};
+static_assert(sizeof(CubeVertex) == 16, "CubeVertex must stay tightly packed");
+typedef uint16_t CubeIndex;
+
+const VertexFormat<CubeVertex> cubeVertexFormat = VertexFormat<CubeVertex>()
+    .attribute(0, &CubeVertex::position, VertexAttributeMode::Float, 3)
+    .attribute(1, &CubeVertex::color, VertexAttributeMode::Normalized, 3)
+    .attribute(2, &CubeVertex::texCoord, VertexAttributeMode::Normalized);
+
+// Pack one vertex of X, Y, Z, R, G, B, U, V floats
+CubeVertex packCubeVertex(const float* v) {
+    CubeVertex vertex;
+    vertex.position[0] = toHalf(v[0]);
+    vertex.position[1] = toHalf(v[1]);
+    vertex.position[2] = toHalf(v[2]);
+    vertex.position[3] = toHalf(1.0f);
+    vertex.color[0] = toUnorm8(v[3]);
+    vertex.color[1] = toUnorm8(v[4]);
+    vertex.color[2] = toUnorm8(v[5]);
+    vertex.color[3] = 255;
+    vertex.texCoord[0] = toUnorm16(v[6]);
+    vertex.texCoord[1] = toUnorm16(v[7]);
+    return vertex;
+}
+
+// The cube of the field under the mouse cursor, as text for the HUD. fieldViewProjection maps the
+// field's space to clip space, so the cursor's ray is cast in the space the BVH was built in.
+std::string pickCube(GLFWwindow* window, const Bvh& bvh, const glm::mat4& fieldViewProjection) {
+    int width, height;
+    double cursorX, cursorY;
+    glfwGetWindowSize(window, &width, &height); // Cursor positions are in window coordinates, not pixels
+    glfwGetCursorPos(window, &cursorX, &cursorY);
+    if (width <= 0 || height <= 0)
+        return "";
+    float x = (float)(cursorX / width * 2.0 - 1.0);
+    float y = (float)(1.0 - cursorY / height * 2.0);
+    // From the near plane to the far plane, so a hit distance of 1 is the far plane
+    glm::mat4 unproject = glm::inverse(fieldViewProjection);
+    glm::vec4 nearPoint = unproject * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 farPoint = unproject * glm::vec4(x, y, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+    BvhRayHit hit;
+    if (!bvh.raycast(origin, direction, 1.0f, hit))
+        return "";
+    return std::format(", cube {} under the cursor", hit.box);
+}
+
+// --- Frames in flight ---
+// The HUD's lines, top to bottom
+enum HudLine {
+    TitleLine,
+    TextStatsLine,
+    CacheStatsLine,
+    LayoutStatsLine,
+    HudStatsLine,
+    RenderQueueStatsLine,
+    GlStateStatsLine,
+    CubeStatsLine,
+    CullStatsLine,
+    OcclusionStatsLine,
+    HudLineCount
+};
+
+// What the render thread reports about a frame it has drawn
+struct FrameResults {
+    bool hudRedrawn = false;
+    int hudWidgetsDrawn = 0;
+    TextStats textStats;             // Of the HUD redraw, if there was one
+    GlyphCacheStats glyphCacheStats; // Likewise
+    bool sdfText = true;             // Which glyph cache drew the text, which is the other if F asked for one that couldn't be created
+    size_t glyphCount = 0;
+    UniformStats uniformStats;
+    RenderQueueStats renderQueueStats;
+    GlStateStats glStateStats;
+    size_t drawCount = 0;            // Cubes drawn from the instance buffer
+    int gpuVisibleCount = -1;        // As GpuCuller::visibleCount()
+    bool occlusionReady = false;
+    OcclusionStats occlusion;
+    double occlusionSeconds = 0.0;
+};
+
+// One frame as the main thread hands it to the render thread: the simulation's results and the
+// frustum culled cubes. The render thread may reorder or shorten visibleCubes, and fills in results.
+struct FramePacket {
+    bool submitted = false;          // Whether results belong to a frame drawn from this slot
+    int width = 0, height = 0;       // Of the framebuffer
+    double time = 0.0, deltaTime = 0.0;
+    ViewSettings settings;
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::mat4 fieldViewProjection = glm::mat4(1.0f);
+    std::vector<uint32_t> visibleCubes;
+    size_t visibleCount = 0;
+    bool hudUpdate = false;          // Set the HUD lines to hudText
+    std::string hudText[HudLineCount];
+    FrameResults results;
+};
+
 // --- Main Function ---
-int main() {
+// --- Command line options ---
+struct Options {
+    size_t glyphAtlasBytes = 256 * 1024; // Memory budget for the glyph cache atlas
+    const char* fontAtlasPath = "font.atlas"; // Cooked font atlas to map instead of rasterizing font.ttf
+    float hudHz = 0.0f;                  // How often the HUD text is updated, 0 for every frame
+    std::string shaderCacheDir = "shader_cache"; // Where linked program binaries are kept, empty to disable
+    size_t cubeCount = 0;                // Cubes in the instanced cube field, 0 for the single cube
+    bool proceduralCube = false;         // Build the cube's vertices from gl_VertexID instead of vertex buffers
+    CullKernel cullKernel = bestCullKernel(); // SIMD width of the cube field's frustum culling
+    std::optional<GpuCullMethod> gpuCullMethod; // How the GPU culls, see GpuCuller.h. The best the context has by default.
+    int jobThreads = -1;                 // Worker threads besides the main one, -1 for one per extra hardware thread
+    bool renderThread = true;            // Draw and swap on a thread of their own
+    unsigned frameQueueDepth = 2;        // Frames the main thread may run ahead of the render thread
+    bool verifyGlState = false;          // Check glState against glGet* after every frame
+    double timeScale = 1.0;              // Simulated seconds per real second
+    double maxFps = 0.0;                 // Frames drawn per second at most, 0 for no limit
+};
+
+// "scalar", "sse" or "avx". Returns false for anything else.
+bool parseCullKernel(const std::string& name, CullKernel& kernel) {
+    if (name == "scalar")
+        kernel = CullKernel::Scalar;
+    else if (name == "sse")
+        kernel = CullKernel::Sse;
+    else if (name == "avx")
+        kernel = CullKernel::Avx;
+    else
+        return false;
+    return true;
+}
+
+// "query", "feedback" or "compute". Returns false for anything else.
+bool parseGpuCullMethod(const std::string& name, GpuCullMethod& method) {
+    if (name == "query")
+        method = GpuCullMethod::Query;
+    else if (name == "feedback")
+        method = GpuCullMethod::Feedback;
+    else if (name == "compute")
+        method = GpuCullMethod::Compute;
+    else
+        return false;
+    return true;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    GpuCullMethod method;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--glyph-atlas-kb" && i + 1 < argc) {
+            options.glyphAtlasBytes = std::strtoul(argv[++i], NULL, 10) * 1024;
+        } else if (arg == "--font-atlas" && i + 1 < argc) {
+            options.fontAtlasPath = argv[++i];
+        } else if (arg == "--shader-cache" && i + 1 < argc) {
+            options.shaderCacheDir = argv[++i];
+        } else if (arg == "--cubes" && i + 1 < argc) {
+            options.cubeCount = std::strtoull(argv[++i], NULL, 10);
+        } else if (arg == "--cull-kernel" && i + 1 < argc && parseCullKernel(argv[i + 1], options.cullKernel)) {
+            std::string kernel = argv[++i];
+            if (supportedCullKernel(options.cullKernel) != options.cullKernel)
+                std::cerr << "This CPU has no " << kernel << " support, culling with " << cullKernelName(bestCullKernel()) << std::endl;
+            options.cullKernel = supportedCullKernel(options.cullKernel);
+        } else if (arg == "--gpu-cull" && i + 1 < argc && parseGpuCullMethod(argv[i + 1], method)) {
+            options.gpuCullMethod = method;
+            ++i;
+            viewSettings.cullMode = CullMode::Gpu;
+        } else if (arg == "--job-threads" && i + 1 < argc) {
+            options.jobThreads = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--no-render-thread") {
+            options.renderThread = false;
+        } else if (arg == "--frame-queue" && i + 1 < argc) {
+            options.frameQueueDepth = (unsigned)std::clamp(std::atoi(argv[++i]), 1, 8);
+        } else if (arg == "--time-scale" && i + 1 < argc) {
+            options.timeScale = std::max(0.0, std::strtod(argv[++i], NULL));
+        } else if (arg == "--max-fps" && i + 1 < argc) {
+            options.maxFps = std::max(0.0, std::strtod(argv[++i], NULL));
+        } else if (arg == "--verify-gl-state") {
+            options.verifyGlState = true;
+        } else if (arg == "--procedural-cube") {
+            options.proceduralCube = true;
+        } else if (arg == "--hud-hz" && i + 1 < argc) {
+            options.hudHz = std::max(0.0f, (float)std::strtod(argv[++i], NULL));
+        } else {
+            std::cerr << "Usage: Cubey [--glyph-atlas-kb <kilobytes>] [--font-atlas <file>] [--hud-hz <rate>] [--shader-cache <dir>] [--cubes <count>] [--procedural-cube] [--cull-kernel scalar|sse|avx] [--gpu-cull query|feedback|compute] [--job-threads <count>] [--no-render-thread] [--frame-queue <frames>] [--time-scale <factor>] [--max-fps <rate>] [--verify-gl-state]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return -1;
+
+    // The cube texture decodes on the job system's threads while the window and context are set up
+    jobSystem.init(options.jobThreads);
+    std::cout << std::format("Job system: {} threads", jobSystem.threadCount()) << std::endl;
+    // Shared with the job, which may outlive main() if it returns early
+    auto smileyImage = std::make_shared<DecodedImage>();
+    JobHandle smileyDecode = jobSystem.submit([smileyImage] { *smileyImage = decodeImage("smiley.png"); });
+
     // --- 1. Initialize GLFW ---
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW" << std::endl;
@@ -278,19 +1186,22 @@ int main() {
         return -1;
     }
     glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+    if (options.cubeCount > 0)
+        glfwSwapInterval(0); // Measure cube throughput, not the display's refresh rate
 
     // --- 3. Initialize GLAD ---
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cerr << "Failed to initialize GLAD" << std::endl;
         return -1;
     }
+    programBinaryCache.init(options.shaderCacheDir, (GLADloadproc)glfwGetProcAddress);
+    glState.setVerification(options.verifyGlState);
     
     // Enable depth testing and blending for 3D and text rendering
     
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_BLEND); // Enable blending for text transparency.
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.enable(GL_DEPTH_TEST);
+    glState.enable(GL_BLEND); // Enable blending for text transparency.
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     // --- 4. Define Cube Geometry ---
     // Each vertex now has 8 floats: X, Y, Z, R, G, B, U, V
@@ -329,133 +1240,568 @@ int main() {
          0.5f,  0.5f,  0.5f,  0.5f, 0.5f, 1.0f,  0.0f, 0.0f,
         -0.5f,  0.5f,  0.5f,  0.5f, 0.5f, 1.0f,  0.0f, 0.0f,
     };
-    unsigned int indices[] = {
+    // Packed for the GPU, see CubeVertex
+    const int vertexCount = sizeof(vertices) / sizeof(float) / 8;
+    CubeVertex packedVertices[vertexCount];
+    for (int i = 0; i < vertexCount; ++i)
+        packedVertices[i] = packCubeVertex(&vertices[i * 8]);
+
+    // The textured front face comes last, so the untextured faces are one range and the textured face another
+    CubeIndex indices[] = {
         0, 1, 2, 2, 3, 0, // Face 1
-        4, 5, 6, 6, 7, 4, // Face 2
         8, 9, 10, 10, 11, 8, // Face 3
         12, 13, 14, 14, 15, 12, // Face 4
         16, 17, 18, 18, 19, 16, // Face 5
-        20, 21, 22, 22, 23, 20  // Face 6
+        20, 21, 22, 22, 23, 20, // Face 6
+        4, 5, 6, 6, 7, 4  // Face 2, textured
     };
 
-    // Setup VAO, VBO, EBO
-    GLuint VAO, VBO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    // Bind and set vertex buffers and attribute pointers
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-
-    // The stride is now 8 floats (3 pos, 3 color, 2 tex)
-    const int stride = 8 * sizeof(float);
+    // Each range of the cube is drawn with the cheapest shader variant its material needs
+    struct CubeMaterial {
+        uint32_t features;
+        GLenum textureTarget;
+        GLuint texture;      // Bound when features include ShaderFeatureTextured
+        GLsizei firstIndex, indexCount; // Also the gl_VertexID range of the procedural cube
+    };
 
-    // Position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
-    glEnableVertexAttribArray(0);
-    // Color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-    // Texture attribute
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
-    glEnableVertexAttribArray(2);
+    // Setup VAO, VBO, EBO. The procedural cube has neither buffer, and its VAO stays empty.
+    const bool proceduralCube = options.proceduralCube;
+    GLuint VAO, VBO = 0, EBO = 0;
+    glGenVertexArrays(1, &VAO);
+    glState.bindVertexArray(VAO);
+    if (!proceduralCube) {
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        // Bind and set vertex buffers and attribute pointers
+        glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(packedVertices), packedVertices, GL_STATIC_DRAW);
+        glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+        // Position, color and texture attributes
+        cubeVertexFormat.apply();
+    }
 
     // --- Load the smiley texture ---
-    loadTexture("smiley.png", cubeTexture);
+    jobSystem.wait(smileyDecode);
+    loadTexture(*smileyImage, cubeTexture);
+
+    // --- The cube field, when one was asked for ---
+    // A second VAO reads the same cube vertices and indices, if any, plus one CubeInstance per cube
+    CubeField cubeField;
+    GLuint fieldVAO = 0;
+    if (options.cubeCount > 0) {
+        if (!cubeField.init(options.cubeCount, CubeTextureLayers)) {
+            glfwTerminate();
+            return -1;
+        }
+        loadTextureArray(*smileyImage, CubeTextureLayers, cubeTextureArray);
+        glGenVertexArrays(1, &fieldVAO);
+        glState.bindVertexArray(fieldVAO);
+        if (!proceduralCube) {
+            glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+            glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            cubeVertexFormat.apply();
+        }
+        cubeField.bindAttributes();
+        std::cout << std::format("Cube field: {} cubes, {:.1f} MB of instance data",
+            cubeField.count(), cubeField.count() * sizeof(CubeInstance) / (1024.0 * 1024.0)) << std::endl;
+    }
+    glState.bindVertexArray(0);
+    const bool drawField = cubeField.count() > 0;
+
+    // The cube field's bounding boxes, in the field's space, for frustum culling
+    FrustumCuller cubeCuller;
+    std::vector<uint32_t> visibleCubes(cubeField.count()); // Indices of the cubes that survive culling
+    cubeCuller.reserve(cubeField.count());
+    for (const CubeInstance& cube : cubeField.instances()) {
+        glm::vec3 center, halfSize;
+        cubeBounds(cube.model, center, halfSize);
+        cubeCuller.addBox(center, halfSize);
+    }
+    // Tests the same boxes against the depth of earlier frames
+    OcclusionCuller occlusionCuller;
+    // And a BVH over them, for culling and picking the cube under the cursor, built by the job
+    // system while the main thread compiles shaders and loads the font
+    Bvh cubeBvh;
+    JobHandle bvhBuild;
+    double bvhBuildSeconds = 0.0;
+    if (drawField) {
+        bvhBuild = jobSystem.submit([&cubeBvh, &cubeCuller, &bvhBuildSeconds] {
+            std::vector<BvhBox> boxes;
+            boxes.reserve(cubeCuller.boxCount());
+            for (size_t i = 0; i < cubeCuller.boxCount(); ++i)
+                boxes.push_back(bvhBox(cubeCuller.center(i), cubeCuller.halfSize(i)));
+            double buildStart = glfwGetTime();
+            cubeBvh.build(boxes, &jobSystem);
+            bvhBuildSeconds = glfwGetTime() - buildStart;
+        });
+    }
+
+    // The GPU culler keeps its own copy of the instances and writes the visible ones to a buffer read by a third VAO
+    GpuCuller gpuCuller;
+    GLuint gpuFieldVAO = 0;
+    if (drawField) {
+        GpuCullMethod gpuCullMethod = options.gpuCullMethod ? *options.gpuCullMethod
+                                                            : GpuCuller::bestMethod((GLADloadproc)glfwGetProcAddress);
+        gpuCullingReady = gpuCuller.init(cubeField.instances(), gpuCullMethod, (GLADloadproc)glfwGetProcAddress);
+    }
+    if (gpuCullingReady) {
+        glGenVertexArrays(1, &gpuFieldVAO);
+        glState.bindVertexArray(gpuFieldVAO);
+        // The Feedback method always draws the procedural cube
+        if (!proceduralCube && gpuCuller.method() != GpuCullMethod::Feedback) {
+            glState.bindBuffer(GL_ARRAY_BUFFER, VBO);
+            glState.bindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            cubeVertexFormat.apply();
+        }
+        bindCubeInstanceAttributes(gpuCuller.visibleBuffer(), gpuCuller.instanceDivisor());
+        glState.bindVertexArray(0);
+    } else if (viewSettings.cullMode == CullMode::Gpu) {
+        viewSettings.cullMode = CullMode::Cpu;
+    }
 
     // --- 5. Compile Shaders and Set Up Matrices ---
-    GLuint cubeShaderProgram = createShaderProgram(vertexShaderSource, fragmentShaderSource);
+    ShaderPermutations cubeShaders;
+    cubeShaders.init("cube", vertexShaderSource, fragmentShaderSource, createShaderProgram, [](ShaderProgram& program, uint32_t features) {
+        program.bindUniformBlock("FrameData", FrameDataBinding);
+        program.bindUniformBlock("ObjectData", ObjectDataBinding);
+        if (program.hasUniform("ourTexture")) { // Only in TEXTURED variants
+            program.use();
+            program.uniform<int>("ourTexture").set(0);
+        }
+        if (features & ShaderFeatureFeedback)
+            cubeFirstTriangle[features] = program.uniform<int>("firstTriangle");
+    });
+    const CubeMaterial cubeMaterials[2] = {
+        { ShaderFeatureVertexColor, GL_TEXTURE_2D, 0, 0, 30 },                                   // Five plain faces
+        { ShaderFeatureTextured | ShaderFeatureVertexColor, GL_TEXTURE_2D, cubeTexture, 30, 6 }  // Front face with smiley.png
+    };
+    // The same ranges for the cube field, with each cube's front face picking a layer of the texture array
+    const CubeMaterial fieldMaterials[2] = {
+        { ShaderFeatureVertexColor | ShaderFeatureInstanced, GL_TEXTURE_2D_ARRAY, 0, 0, 30 },
+        { ShaderFeatureTextured | ShaderFeatureVertexColor | ShaderFeatureInstanced, GL_TEXTURE_2D_ARRAY, cubeTextureArray, 30, 6 }
+    };
+    // Added to every material's features when the cube comes from gl_VertexID
+    const uint32_t cubeGeometryFeatures = proceduralCube ? (uint32_t)ShaderFeatureProcedural : 0u;
 
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
-    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -3.0f));
+    // Back the camera off until the whole cube field fits in the 45 degree field of view
+    float cameraDistance = drawField ? cubeField.radius() / std::sin(glm::radians(22.5f)) : 3.0f;
+    float farPlane = std::max(100.0f, cameraDistance + cubeField.radius() + 1.0f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, farPlane);
+    glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -cameraDistance));
+    uniformRing.init(16 * 1024); // Grows if a frame ever needs more
 
     // --- 6. Font Loading and Text Rendering Setup ---
-    textShaderProgram = createShaderProgram(textVertexShaderSource, textFragmentShaderSource);
-    loadFont("font.ttf"); // Make sure font.ttf is in your project or exe root
+    // The cube variants are built as they are first drawn; these programs are needed up front
+    double shaderSetupStart = glfwGetTime();
+    createTextProgram(textProgram, textVertexShaderSource, textFragmentShaderSource, false);
+    createTextProgram(textInstancedProgram, textInstancedVertexShaderSource, textFragmentShaderSource, true);
+    createTextProgram(textSdfProgram, textVertexShaderSource, textSdfFragmentShaderSource, false);
+    createTextProgram(textInstancedSdfProgram, textInstancedVertexShaderSource, textSdfFragmentShaderSource, true);
+    GLuint hudProgram = createShaderProgram(hudVertexShaderSource, hudFragmentShaderSource);
+    double shaderSetupSeconds = glfwGetTime() - shaderSetupStart;
+    const ProgramBinaryCacheStats& programStats = programBinaryCache.stats();
+    std::cout << std::format("Text and HUD shader programs ready in {:.1f} ms ({} from the binary cache, {} compiled and cached, {} stale binaries)",
+        shaderSetupSeconds * 1000.0, programStats.loaded, programStats.stored, programStats.rejected) << std::endl;
+    glyphAtlasBudget = options.glyphAtlasBytes;
+    bool fontLoaded = loadCookedFont(options.fontAtlasPath);
+    if (!fontLoaded) {
+        std::cerr << "Rasterizing glyphs from " << FontPath << " instead" << std::endl;
+        fontLoaded = initGlyphCache(sdfText);
+    }
+    if (!fontLoaded) {
+        jobSystem.wait(bvhBuild); // It still writes to cubeBvh
+        glfwTerminate();
+        return -1;
+    }
+    setupTextRendering();
+
+    // The overlay lines, kept in the HUD texture and redrawn only when their text changes
+    Hud hud;
+    hud.init(hudProgram);
+    size_t hudWidgets[HudLineCount];
+    hudWidgets[TitleLine] = hud.addText("", 25.0f, 50.0f, 1.0f);
+    // The status lines are drawn at half size, which stays crisp with the SDF atlas
+    for (int line = TextStatsLine; line < HudLineCount; ++line)
+        hudWidgets[line] = hud.addText("", 25.0f, 85.0f + 25.0f * (line - TextStatsLine), 0.5f);
+
+    if (drawField) {
+        jobSystem.wait(bvhBuild);
+        std::cout << std::format("Cube field BVH: {} nodes, built in {:.1f} ms", cubeBvh.nodeCount(), bvhBuildSeconds * 1000.0) << std::endl;
+    }
 
     // Random rotation speeds
     std::mt19937 gen(std::random_device{}()); // Random number generator
-    std::uniform_real_distribution<float> rndDistrib(0.1f, 2.0f); // Random speed between .1 and 2 degrees per frame
+    std::uniform_real_distribution<float> rndDistrib(0.1f, 2.0f); // Random speed between .1 and 2 degrees per step
     float rotationXSpeed = rndDistrib(gen);
     float rotationYSpeed = rndDistrib(gen);
 
-    float rotationX = 0.0f;
-    float rotationY = 0.0f;
+    SimulationState simulation;
+    SimulationState previousSimulation; // The state one step before, drawn from when between the two
+    double simulationTime = 0.0;        // Simulated seconds not yet run as steps
+
+    // The scene's transforms. The cube, or the whole cube field, is the one root.
+    TransformStore sceneTransforms;
+    TransformId cubeTransform = sceneTransforms.create();
+
+    // The loaded font decides which glyph cache text starts with
+    viewSettings.textMode = textMode;
+    viewSettings.sdfText = sdfText;
+
+    // Counters from the frames the render thread has finished, shown in the HUD
+    FrameResults lastResults;
+    TextStats lastTextStats; // Text counters from the previous HUD redraw
+    GlyphCacheStats lastGlyphCacheStats;
+    UniformStats uniformStats; // Since the HUD text was last updated
+    int lastHudWidgetsDrawn = 0;
+    int hudRedraws = 0;       // HUD redraws since hudFrames was last reset
+    int hudFrames = 0;
+    double lastHudUpdate = -1.0;
+    double startTime = glfwGetTime();
+    double lastFrameTime = startTime;
+    // Cube throughput, measured over windows of at least half a second
+    const size_t cubesPerFrame = drawField ? cubeField.count() : 1;
+    size_t totalFrames = 0;
+    double throughputStart = startTime;
+    size_t throughputFrames = 0;
+    double framesPerSecond = 0.0;
+    double cullSeconds = 0.0; // Time the last frame spent frustum culling the cube field
+    const glm::mat4 viewProjection = projection * view;
+
+    // --- Frames in flight ---
+    // The main thread fills a slot while the render thread draws from the others
+    std::vector<FramePacket> frames(options.frameQueueDepth);
+    for (FramePacket& frame : frames)
+        frame.visibleCubes.resize(cubeField.count());
+
+    // Draw one frame from its slot. Only the render thread calls this once the loop runs, and the
+    // state it touches, from the GL objects to the HUD, is left to it.
+    TextMode hudTextMode = textMode;
+    bool hudSdfText = sdfText;
+    int viewportWidth = 0, viewportHeight = 0;
+    // A GPU culled cube draw, issued by the render queue with its program bound
+    struct GpuCulledDraw {
+        GpuCuller* culler;
+        Uniform<int> firstTriangle; // Unresolved, and so ignored, without FEEDBACK
+        uint32_t geometryFeatures;
+    };
+    auto drawGpuCulled = [](const DrawItem& item, const void* context) {
+        const GpuCulledDraw& draw = *static_cast<const GpuCulledDraw*>(context);
+        draw.firstTriangle.set(item.first / 3);
+        draw.culler->draw(item.first, item.count, (draw.geometryFeatures & ShaderFeatureProcedural) ? 0 : item.indexType);
+    };
+    std::vector<GpuCulledDraw> gpuCulledDraws;
+
+    auto renderFrame = [&](FramePacket& frame) {
+        FrameResults& results = frame.results;
+        results = FrameResults();
+        textMode = frame.settings.textMode;
+        sdfText = frame.settings.sdfText;
+        if (!initGlyphCache(sdfText))
+            sdfText = !sdfText; // Keep drawing with the cache that exists
+        results.sdfText = sdfText;
+        if (frame.width != viewportWidth || frame.height != viewportHeight) {
+            glViewport(0, 0, frame.width, frame.height);
+            viewportWidth = frame.width;
+            viewportHeight = frame.height;
+        }
 
-    // --- Main Render Loop 
-    while (!glfwWindowShouldClose(window)) {
-        // Input processing
-        processInput(window, rotationX, rotationY);
-        rotationX += rotationXSpeed;
-        rotationY += rotationYSpeed;
-        if (rotationX > 360.0f || rotationX < -360.0f ) rotationX = 0.0f;
-        if (rotationY > 360.0f || rotationY < -360.0f ) rotationY = 0.0f;
+        // --- Uniform blocks for this frame, uploaded in one go ---
+        uniformRing.beginFrame();
+        FrameData frameData;
+        frameData.view = view;
+        frameData.projection = projection;
+        frameData.viewProjection = viewProjection;
+        // Flip the projection's Y-axis to match the font library.
+        // The arguments are left, right, bottom, top.
+        // We set bottom=height and top=0 to make Y increase downwards.
+        frameData.ortho = glm::ortho(0.0f, static_cast<float>(frame.width), static_cast<float>(frame.height), 0.0f);
+        frameData.viewport = glm::vec4((float)frame.width, (float)frame.height, 1.0f / std::max(frame.width, 1), 1.0f / std::max(frame.height, 1));
+        frameData.time = glm::vec4((float)frame.time, (float)frame.deltaTime, 0.0f, 0.0f);
+        size_t frameDataOffset = uniformRing.push(frameData);
+        ObjectData cubeData;
+        cubeData.model = frame.model;
+        size_t cubeDataOffset = uniformRing.push(cubeData);
+
+        // --- Upload the cubes the main thread's frustum culling left, or cull on the GPU ---
+        const CullMode cullMode = frame.settings.cullMode;
+        const bool gpuCulled = drawField && cullMode == CullMode::Gpu;
+        const bool cpuCulled = drawField && (cullMode == CullMode::Cpu || cullMode == CullMode::Bvh);
+        const bool occlusionCulled = cpuCulled && frame.settings.occlusionCulling;
+        if (!occlusionCulled)
+            occlusionCuller.invalidate(); // Depth captured before a pause no longer matches the field
+        if (cpuCulled) {
+            size_t visibleCount = frame.visibleCount;
+            if (occlusionCulled) {
+                // The depth pyramid comes from this thread's readbacks, so occlusion culling stays here
+                double occlusionStart = glfwGetTime();
+                visibleCount = occlusionCuller.cull(cubeCuller, frame.visibleCubes.data(), visibleCount);
+                results.occlusionSeconds = glfwGetTime() - occlusionStart;
+            }
+            cubeField.uploadInstances(frame.visibleCubes.data(), visibleCount);
+        } else if (gpuCulled) {
+            gpuCuller.cull(extractFrustum(frame.fieldViewProjection));
+        } else if (drawField) {
+            cubeField.uploadAll();
+        }
+
+        uniformRing.upload();
+        uniformRing.bind<FrameData>(FrameDataBinding, frameDataOffset);
 
         // Rendering
-        glEnable(GL_DEPTH_TEST); // Ensure depth test is on for the 3D part
+        glState.enable(GL_DEPTH_TEST); // Ensure depth test is on for the 3D part
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(cubeShaderProgram);
-        
-        // --- Bind the texture before drawing ---
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture);
-        // Tell the shader which texture unit to use (0)
-        glUniform1i(glGetUniformLocation(cubeShaderProgram, "ourTexture"), 0);
+        // In the cube field, the cube's model matrix turns the whole field
+        uniformRing.bind<ObjectData>(ObjectDataBinding, cubeDataOffset);
+        uint32_t geometryFeatures = cubeGeometryFeatures;
+        if (gpuCulled && gpuCuller.method() == GpuCullMethod::Feedback)
+            geometryFeatures |= ShaderFeatureProcedural | ShaderFeatureFeedback;
+        gpuCulledDraws.clear();
+        gpuCulledDraws.reserve(std::size(cubeMaterials)); // Queued draws point into it until the flush
+        glState.activeTexture(GL_TEXTURE0);
+        for (const CubeMaterial& material : drawField ? fieldMaterials : cubeMaterials) {
+            uint32_t features = material.features | geometryFeatures;
+            ShaderProgram& program = cubeShaders.get(features);
+            DrawItem item;
+            item.program = program.id();
+            item.vertexArray = gpuCulled ? gpuFieldVAO : drawField ? fieldVAO : VAO;
+            if (material.features & ShaderFeatureTextured) {
+                item.textureTarget = material.textureTarget;
+                item.texture = material.texture;
+            }
+            item.first = material.firstIndex;
+            item.count = material.indexCount;
+            item.indexType = IndexType<CubeIndex>::value;
+            item.instances = (GLsizei)cubeField.drawCount();
+            if (gpuCulled) {
+                gpuCulledDraws.push_back({ &gpuCuller, cubeFirstTriangle[features], geometryFeatures });
+                item.kind = DrawKind::Custom;
+                item.custom = drawGpuCulled;
+                item.context = &gpuCulledDraws.back();
+            } else if (proceduralCube) {
+                item.kind = drawField ? DrawKind::ArraysInstanced : DrawKind::Arrays;
+            } else {
+                item.kind = drawField ? DrawKind::ElementsInstanced : DrawKind::Elements;
+            }
+            // Every cube material covers the same cubes, so there is no depth to order by
+            renderQueue.submit(RenderQueue::sortKey(SceneLayer, item.program, item.texture, item.vertexArray, 0.0f), item);
+        }
+        renderQueue.flush();
+        // The cubes just drawn hide the ones behind them a couple of frames from now
+        if (occlusionCulled)
+            occlusionCuller.captureDepth(frame.width, frame.height, frame.fieldViewProjection);
+
+        // --- RENDER 2D TEXT ---
+        glState.disable(GL_DEPTH_TEST); // Disable depth test for the 2D overlay.
 
-        // Update model matrix for rotation
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::rotate(model, glm::radians(rotationX), glm::vec3(1.0f, 0.0f, 0.0f));
-        model = glm::rotate(model, glm::radians(rotationY), glm::vec3(0.0f, 1.0f, 0.0f));
+        hud.resize(frame.width, frame.height);
+        if (textMode != hudTextMode || sdfText != hudSdfText) {
+            hudTextMode = textMode;
+            hudSdfText = sdfText;
+            hud.invalidate();
+        }
+        if (frame.hudUpdate) {
+            for (int line = 0; line < HudLineCount; ++line)
+                hud.setText(hudWidgets[line], frame.hudText[line]);
+        }
+        if (hud.isDirty()) {
+            // The text programs read the orthographic projection from FrameData
+            beginTextFrame(); // Glyphs used from here on can't be evicted until the next frame
+            results.hudWidgetsDrawn = hud.redraw(
+                [](const HudWidget& widget) { return queueText(widget.text, widget.x, widget.y, widget.scale, widget.color); },
+                flushText); // The redrawn lines go out in a single upload and draw
+            results.hudRedrawn = true;
+            results.textStats = resetTextStats();
+            results.glyphCacheStats = activeGlyphCache().resetStats();
+        }
+        hud.composite();
+        uniformRing.endFrame();
+
+        results.drawCount = cubeField.drawCount();
+        results.glyphCount = activeGlyphCache().glyphCount();
+        results.uniformStats = ShaderProgram::resetStats();
+        results.renderQueueStats = renderQueue.resetStats();
+        results.glStateStats = glState.resetStats();
+        glState.verify("end of frame");
+        results.gpuVisibleCount = gpuCullingReady ? gpuCuller.visibleCount() : -1;
+        results.occlusionReady = occlusionCuller.ready();
+        results.occlusion = occlusionCuller.stats();
+    };
 
-        // Calculate final MVP matrix and send to shader
-        glm::mat4 mvp = projection * view * model;
-        glUniformMatrix4fv(glGetUniformLocation(cubeShaderProgram, "mvp"), 1, GL_FALSE, glm::value_ptr(mvp));
+    // From here on the GL context belongs to the render thread
+    RenderThread renderThread;
+    renderThread.start(window, options.frameQueueDepth, options.renderThread);
 
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+    // --- Main Render Loop 
+    while (!glfwWindowShouldClose(window)) {
+        // Waits while the render thread is frameQueueDepth frames behind
+        FramePacket& frame = frames[renderThread.beginFrame()];
+        if (frame.submitted) {
+            // The render thread has finished with this slot, so what it reported can be read
+            lastResults = frame.results;
+            if (lastResults.hudRedrawn) {
+                hudRedraws++;
+                lastHudWidgetsDrawn = lastResults.hudWidgetsDrawn;
+                lastTextStats = lastResults.textStats;
+                lastGlyphCacheStats = lastResults.glyphCacheStats;
+            }
+            uniformStats.uploads += lastResults.uniformStats.uploads;
+            uniformStats.skipped += lastResults.uniformStats.skipped;
+        }
 
-        // --- RENDER 2D TEXT ---
-        glDisable(GL_DEPTH_TEST); // Disable depth test for the 2D overlay.
+        // Drawing less often doesn't slow the simulation, which catches up in whole steps
+        if (options.maxFps > 0.0) {
+            double wait = lastFrameTime + 1.0 / options.maxFps - glfwGetTime();
+            if (wait > 0.0)
+                std::this_thread::sleep_for(std::chrono::duration<double>(wait));
+        }
+
+        // Input processing
+        processInput(window);
+
+        glfwGetFramebufferSize(window, &frame.width, &frame.height);
+        double now = glfwGetTime();
+        frame.settings = viewSettings;
+        frame.time = now - startTime;
+        frame.deltaTime = now - lastFrameTime;
+        lastFrameTime = now;
+
+        // --- Run the simulation up to now in fixed steps ---
+        simulationTime += std::min(frame.deltaTime, MaxFrameTime) * options.timeScale;
+        while (simulationTime >= SimulationStep) {
+            previousSimulation = simulation;
+            simulate(window, simulation, rotationXSpeed, rotationYSpeed);
+            simulationTime -= SimulationStep;
+        }
+        // Draw the scene between the last two steps, as far along as the leftover time
+        float blend = (float)(simulationTime / SimulationStep);
 
-        
-        int width, height;
-        glfwGetFramebufferSize(window, &width, &height);
+        // Update model matrix for rotation
+        sceneTransforms.setRotation(cubeTransform, glm::slerp(cubeRotation(previousSimulation), cubeRotation(simulation), blend));
+        sceneTransforms.update(&jobSystem);
+        frame.model = sceneTransforms.world(cubeTransform);
+        frame.fieldViewProjection = viewProjection * frame.model;
+
+        // --- Frustum cull the cube field, in its own space ---
+        const CullMode cullMode = viewSettings.cullMode;
+        const bool cpuCulled = drawField && (cullMode == CullMode::Cpu || cullMode == CullMode::Bvh);
+        const bool occlusionCulled = cpuCulled && viewSettings.occlusionCulling;
+        frame.visibleCount = 0;
+        if (cpuCulled) {
+            double cullStart = glfwGetTime();
+            Frustum frustum = extractFrustum(frame.fieldViewProjection);
+            frame.visibleCount = cullMode == CullMode::Bvh ? cubeBvh.cull(frustum, frame.visibleCubes.data())
+                                                           : cubeCuller.cull(frustum, frame.visibleCubes.data(), options.cullKernel, jobSystem);
+            cullSeconds = glfwGetTime() - cullStart;
+        }
 
-        // Flip the projection's Y-axis to match the font library.
-        // The arguments are left, right, bottom, top.
-        // We set bottom=height and top=0 to make Y increase downwards.
-        glm::mat4 ortho_projection = glm::ortho(0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f);
-        
-        glUseProgram(textShaderProgram);
-        glUniformMatrix4fv(glGetUniformLocation(textShaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(ortho_projection));
-        
-        // Since y=0 is now the top of the screen, we use a small positive
-        //std::string txt = "Arrow keys control the rotation " + std::to_string(rotationX) + ", " + std::to_string(rotationY);
-        std::string txt = std::format("Arrow keys control the rotation ({:.1f}, {:.1f})", rotationX, rotationY);
-        renderText(txt, 25.0f, 50.0f, 1.0f);
-
-                
-        // Swap buffers and poll IO events
-        glfwSwapBuffers(window);
+        totalFrames++;
+        throughputFrames++;
+        if (now - throughputStart >= 0.5) {
+            framesPerSecond = throughputFrames / (now - throughputStart);
+            throughputStart = now;
+            throughputFrames = 0;
+        }
+
+        // The HUD text can change less often than the scene is drawn
+        frame.hudUpdate = options.hudHz <= 0.0f || now - lastHudUpdate >= 1.0 / options.hudHz;
+        if (frame.hudUpdate) {
+            lastHudUpdate = now;
+            std::string* text = frame.hudText;
+            text[TitleLine] = std::format("Arrow keys control the rotation ({:.1f}, {:.1f})", simulation.rotationX, simulation.rotationY);
+            text[TextStatsLine] = std::format("Text ({}, T to switch): {} glyphs, {} draws, {} bytes",
+                viewSettings.textMode == TextMode::Batched ? "batched" : "instanced",
+                lastTextStats.glyphs, lastTextStats.drawCalls, lastTextStats.bytesUploaded);
+            text[CacheStatsLine] = std::format("{} glyph cache (F to switch): {} glyphs, {} misses, {} evictions",
+                lastResults.sdfText ? "SDF" : "Coverage", lastResults.glyphCount, lastGlyphCacheStats.misses, lastGlyphCacheStats.evictions);
+            text[LayoutStatsLine] = std::format("Layout cache: {} hits, {} partial, {} misses, {} glyphs laid out",
+                lastTextStats.labelHits, lastTextStats.labelPartialHits, lastTextStats.labelMisses, lastTextStats.glyphsLaidOut);
+            text[HudStatsLine] = std::format("HUD: {} of {} frames redrawn, {} widgets last time. Uniforms: {} set, {} unchanged",
+                hudRedraws, hudFrames, lastHudWidgetsDrawn, uniformStats.uploads, uniformStats.skipped);
+            const RenderQueueStats& queueStats = lastResults.renderQueueStats;
+            text[RenderQueueStatsLine] = std::format("Render queue: {} draws, {} program, {} texture, {} vertex array changes",
+                queueStats.draws, queueStats.programChanges, queueStats.textureChanges, queueStats.vertexArrayChanges);
+            text[GlStateStatsLine] = std::format("GL state: {} calls made, {} redundant calls dropped{}",
+                lastResults.glStateStats.calls, lastResults.glStateStats.dropped, glState.verifying() ? ", verified every frame" : "");
+            text[CubeStatsLine] = std::format("Cubes: {} per frame, {:.0f} fps, {:.2f} M cubes/s, {} frames queued{}",
+                cubesPerFrame, framesPerSecond, cubesPerFrame * framesPerSecond / 1e6, renderThread.frameQueueDepth(),
+                renderThread.threaded() ? " to the render thread" : "");
+            if (!drawField)
+                text[CullStatsLine] = "";
+            else if (cullMode == CullMode::Cpu)
+                text[CullStatsLine] = std::format("Frustum culling (C to switch): CPU {} on {} threads, {} of {} cubes visible, {:.2f} ms",
+                    cullKernelName(options.cullKernel), jobSystem.threadCount(), lastResults.drawCount, cubeField.count(), cullSeconds * 1000.0);
+            else if (cullMode == CullMode::Bvh)
+                text[CullStatsLine] = std::format("Frustum culling (C to switch): BVH, {} of {} cubes visible, {:.2f} ms{}",
+                    lastResults.drawCount, cubeField.count(), cullSeconds * 1000.0, pickCube(window, cubeBvh, frame.fieldViewProjection));
+            else if (cullMode == CullMode::Gpu && lastResults.gpuVisibleCount >= 0)
+                text[CullStatsLine] = std::format("Frustum culling (C to switch): GPU {}, {} of {} cubes visible",
+                    gpuCullMethodName(gpuCuller.method()), lastResults.gpuVisibleCount, cubeField.count());
+            else if (cullMode == CullMode::Gpu)
+                text[CullStatsLine] = std::format("Frustum culling (C to switch): GPU {}, visible count stays on the GPU",
+                    gpuCullMethodName(gpuCuller.method()));
+            else
+                text[CullStatsLine] = "Frustum culling (C to switch): off";
+            if (!drawField)
+                text[OcclusionStatsLine] = "";
+            else if (!occlusionCulled)
+                text[OcclusionStatsLine] = std::format("Occlusion culling (O to switch): {}", cpuCulled ? "off" : "needs CPU culling");
+            else if (!lastResults.occlusionReady)
+                text[OcclusionStatsLine] = "Occlusion culling (O to switch): waiting for depth";
+            else
+                text[OcclusionStatsLine] = std::format("Occlusion culling (O to switch): {} of {} cubes hidden, {:.2f} ms",
+                    lastResults.occlusion.occluded, lastResults.occlusion.tested, lastResults.occlusionSeconds * 1000.0);
+            hudRedraws = hudFrames = 0;
+            uniformStats = UniformStats();
+        }
+        hudFrames++;
+
+        // Hand the frame over. The captures are references and a pointer, so each command is a few bytes in the ring.
+        frame.submitted = true;
+        renderThread.push([&renderFrame, &frame] { renderFrame(frame); });
+        renderThread.push([window] { glfwSwapBuffers(window); });
+        renderThread.endFrame();
+
+        // Poll IO events while the render thread draws and swaps
         glfwPollEvents();
     }
+    // Everything after this runs on the main thread again
+    renderThread.stop();
+
+    double runTime = glfwGetTime() - startTime;
+    std::cout << std::format("Drew {} frames of {} cubes in {:.1f} s: {:.2f} M cubes/s",
+        totalFrames, cubesPerFrame, runTime, runTime > 0.0 ? totalFrames * cubesPerFrame / runTime / 1e6 : 0.0) << std::endl;
 
     // --- 7. Cleanup ---
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
-    glDeleteProgram(cubeShaderProgram);
+    glState.deleteVertexArrays(1, &VAO);
+    glState.deleteVertexArrays(1, &fieldVAO);
+    glState.deleteVertexArrays(1, &gpuFieldVAO);
+    gpuCuller.destroy();
+    occlusionCuller.destroy();
+    cubeField.destroy();
+    glState.deleteTextures(1, &cubeTextureArray);
+    glState.deleteBuffers(1, &VBO);
+    glState.deleteBuffers(1, &EBO);
+    cubeShaders.destroy();
     
-    glDeleteVertexArrays(1, &textVAO);
-    glDeleteBuffers(1, &textVBO);
-    glDeleteProgram(textShaderProgram);
-    glDeleteTextures(1, &cubeTexture); // Delete the cube texture
+    glState.deleteVertexArrays(1, &textVAO);
+    glState.deleteBuffers(1, &textVBO);
+    textProgram.program.destroy();
+    glState.deleteVertexArrays(1, &textInstancedVAO);
+    glState.deleteBuffers(1, &textInstanceVBO);
+    glyphCache.destroy();
+    sdfGlyphCache.destroy();
+    textSdfProgram.program.destroy();
+    textInstancedSdfProgram.program.destroy();
+    textInstancedProgram.program.destroy();
+    glState.deleteTextures(1, &cubeTexture); // Delete the cube texture
+    hud.destroy();
+    uniformRing.destroy();
+    jobSystem.shutdown();
 
     glfwDestroyWindow(window);
     glfwTerminate(); // Terminate GLFW
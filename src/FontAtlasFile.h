@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// --- Cooked font atlas file ---
+// Written at build time by tools/FontCooker.cpp and memory-mapped at runtime, so loading a font
+// needs no TTF parsing or rasterization. The file is little-endian and laid out as:
+//   FontAtlasHeader
+//   FontAtlasGlyph[glyphCount]
+//   atlasWidth * usedHeight bytes of single-channel atlas pixels, the rest of the atlas is empty
+
+const char FontAtlasMagic[4] = { 'C', 'B', 'F', 'A' };
+const uint32_t FontAtlasVersion = 1;
+
+struct FontAtlasHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t raster;          // GlyphRaster: 0 = coverage, 1 = signed distance field
+    float pixelHeight;        // Size the glyphs were rasterized at
+    uint32_t atlasWidth, atlasHeight;
+    uint32_t usedHeight;      // Rows from here down are free for glyphs rasterized at runtime
+    uint32_t glyphCount;
+};
+static_assert(sizeof(FontAtlasHeader) == 32, "FontAtlasHeader layout is part of the file format");
+
+struct FontAtlasGlyph {
+    uint32_t codepoint;
+    uint16_t x0, y0, x1, y1;  // Atlas rectangle, x1/y1 exclusive
+    float xoff, yoff;         // Offset from the pen position to the top-left of the quad
+    float xadvance;
+};
+static_assert(sizeof(FontAtlasGlyph) == 24, "FontAtlasGlyph layout is part of the file format");
+
+// Check that data holds a complete atlas file. Returns the header, or nullptr if it is malformed.
+inline const FontAtlasHeader* validateFontAtlas(const void* data, size_t size) {
+    if (size < sizeof(FontAtlasHeader))
+        return nullptr;
+    const FontAtlasHeader* header = static_cast<const FontAtlasHeader*>(data);
+    if (std::memcmp(header->magic, FontAtlasMagic, 4) != 0 || header->version != FontAtlasVersion || header->raster > 1)
+        return nullptr;
+    size_t expected = sizeof(FontAtlasHeader) + (size_t)header->glyphCount * sizeof(FontAtlasGlyph)
+                    + (size_t)header->atlasWidth * header->usedHeight;
+    if (header->usedHeight > header->atlasHeight || size < expected)
+        return nullptr;
+    return header;
+}
+
+inline const FontAtlasGlyph* fontAtlasGlyphs(const FontAtlasHeader* header) {
+    return reinterpret_cast<const FontAtlasGlyph*>(header + 1);
+}
+
+inline const unsigned char* fontAtlasPixels(const FontAtlasHeader* header) {
+    return reinterpret_cast<const unsigned char*>(fontAtlasGlyphs(header) + header->glyphCount);
+}
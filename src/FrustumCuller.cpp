@@ -0,0 +1,209 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "CpuFeatures.h"
+
+#ifdef CUBEY_X86
+#include <immintrin.h>
+#endif
+
+Frustum extractFrustum(const glm::mat4& m) {
+    // Gribb and Hartmann: each plane is the last row of the matrix plus or minus one of the others
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; ++i)
+        rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+
+    Frustum frustum;
+    frustum.planes[0] = rows[3] + rows[0];
+    frustum.planes[1] = rows[3] - rows[0];
+    frustum.planes[2] = rows[3] + rows[1];
+    frustum.planes[3] = rows[3] - rows[1];
+    frustum.planes[4] = rows[3] + rows[2];
+    frustum.planes[5] = rows[3] - rows[2];
+    for (glm::vec4& plane : frustum.planes) {
+        float length = std::sqrt(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z);
+        if (length > 0.0f)
+            plane = plane / length;
+    }
+    return frustum;
+}
+
+const char* cullKernelName(CullKernel kernel) {
+    switch (kernel) {
+    case CullKernel::Sse: return "SSE";
+    case CullKernel::Avx: return "AVX";
+    default: return "scalar";
+    }
+}
+
+CullKernel bestCullKernel() {
+    const CpuFeatures& cpu = cpuFeatures();
+    if (cpu.avx) return CullKernel::Avx;
+    if (cpu.sse2) return CullKernel::Sse;
+    return CullKernel::Scalar;
+}
+
+CullKernel supportedCullKernel(CullKernel kernel) {
+    const CpuFeatures& cpu = cpuFeatures();
+    if ((kernel == CullKernel::Avx && !cpu.avx) || (kernel == CullKernel::Sse && !cpu.sse2))
+        return bestCullKernel();
+    return kernel;
+}
+
+void FrustumCuller::clear() {
+    for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &halfX, &halfY, &halfZ })
+        component->clear();
+}
+
+void FrustumCuller::reserve(size_t boxes) {
+    for (std::vector<float>* component : { &centerX, &centerY, &centerZ, &halfX, &halfY, &halfZ })
+        component->reserve(boxes);
+}
+
+void FrustumCuller::addBox(const glm::vec3& center, const glm::vec3& halfSize) {
+    centerX.push_back(center.x);
+    centerY.push_back(center.y);
+    centerZ.push_back(center.z);
+    halfX.push_back(halfSize.x);
+    halfY.push_back(halfSize.y);
+    halfZ.push_back(halfSize.z);
+}
+
+namespace {
+    // The boxes and planes a kernel works on
+    struct CullInput {
+        const float *cx, *cy, *cz, *hx, *hy, *hz;
+        size_t count;
+        uint32_t base;         // Index of the first box, added to the indices written out
+        float planes[6][4];    // As in Frustum
+        float absPlanes[6][3]; // |normal|, projects a box's half size onto the normal
+    };
+
+    // A box is outside when even its corner farthest along the normal is behind a plane
+    size_t cullScalar(const CullInput& in, size_t first, uint32_t* visible, size_t visibleCount) {
+        for (size_t i = first; i < in.count; ++i) {
+            bool inside = true;
+            for (int p = 0; p < 6 && inside; ++p) {
+                float distance = in.planes[p][0] * in.cx[i] + in.planes[p][1] * in.cy[i] + in.planes[p][2] * in.cz[i] + in.planes[p][3];
+                float radius = in.absPlanes[p][0] * in.hx[i] + in.absPlanes[p][1] * in.hy[i] + in.absPlanes[p][2] * in.hz[i];
+                inside = distance + radius >= 0.0f;
+            }
+            visible[visibleCount] = in.base + (uint32_t)i;
+            visibleCount += inside;
+        }
+        return visibleCount;
+    }
+
+#ifdef CUBEY_X86
+    CUBEY_TARGET_SSE2 size_t cullSse(const CullInput& in, uint32_t* visible) {
+        size_t visibleCount = 0;
+        size_t i = 0;
+        for (; i + 4 <= in.count; i += 4) {
+            __m128 cx = _mm_loadu_ps(in.cx + i), cy = _mm_loadu_ps(in.cy + i), cz = _mm_loadu_ps(in.cz + i);
+            __m128 hx = _mm_loadu_ps(in.hx + i), hy = _mm_loadu_ps(in.hy + i), hz = _mm_loadu_ps(in.hz + i);
+            __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p) {
+                __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(in.planes[p][0]), cx),
+                                                        _mm_mul_ps(_mm_set1_ps(in.planes[p][1]), cy)),
+                                             _mm_add_ps(_mm_mul_ps(_mm_set1_ps(in.planes[p][2]), cz),
+                                                        _mm_set1_ps(in.planes[p][3])));
+                __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(in.absPlanes[p][0]), hx),
+                                                      _mm_mul_ps(_mm_set1_ps(in.absPlanes[p][1]), hy)),
+                                           _mm_mul_ps(_mm_set1_ps(in.absPlanes[p][2]), hz));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, radius), _mm_setzero_ps()));
+                if (_mm_movemask_ps(inside) == 0)
+                    break; // All four are out, skip the remaining planes
+            }
+            // Compact without branching: every index is written, and the count only moves past the visible ones
+            int mask = _mm_movemask_ps(inside);
+            for (int k = 0; k < 4; ++k) {
+                visible[visibleCount] = in.base + (uint32_t)(i + k);
+                visibleCount += (mask >> k) & 1;
+            }
+        }
+        return cullScalar(in, i, visible, visibleCount);
+    }
+
+    CUBEY_TARGET_AVX size_t cullAvx(const CullInput& in, uint32_t* visible) {
+        size_t visibleCount = 0;
+        size_t i = 0;
+        for (; i + 8 <= in.count; i += 8) {
+            __m256 cx = _mm256_loadu_ps(in.cx + i), cy = _mm256_loadu_ps(in.cy + i), cz = _mm256_loadu_ps(in.cz + i);
+            __m256 hx = _mm256_loadu_ps(in.hx + i), hy = _mm256_loadu_ps(in.hy + i), hz = _mm256_loadu_ps(in.hz + i);
+            __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; ++p) {
+                __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(in.planes[p][0]), cx),
+                                                              _mm256_mul_ps(_mm256_set1_ps(in.planes[p][1]), cy)),
+                                                _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(in.planes[p][2]), cz),
+                                                              _mm256_set1_ps(in.planes[p][3])));
+                __m256 radius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(in.absPlanes[p][0]), hx),
+                                                            _mm256_mul_ps(_mm256_set1_ps(in.absPlanes[p][1]), hy)),
+                                              _mm256_mul_ps(_mm256_set1_ps(in.absPlanes[p][2]), hz));
+                inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(distance, radius), _mm256_setzero_ps(), _CMP_GE_OQ));
+                if (_mm256_movemask_ps(inside) == 0)
+                    break;
+            }
+            int mask = _mm256_movemask_ps(inside);
+            for (int k = 0; k < 8; ++k) {
+                visible[visibleCount] = in.base + (uint32_t)(i + k);
+                visibleCount += (mask >> k) & 1;
+            }
+        }
+        return cullScalar(in, i, visible, visibleCount);
+    }
+#endif
+}
+
+size_t FrustumCuller::cullRange(const Frustum& frustum, uint32_t* visible, CullKernel kernel, size_t first, size_t count) const {
+    CullInput in;
+    in.cx = centerX.data() + first; in.cy = centerY.data() + first; in.cz = centerZ.data() + first;
+    in.hx = halfX.data() + first; in.hy = halfY.data() + first; in.hz = halfZ.data() + first;
+    in.count = count;
+    in.base = (uint32_t)first;
+    for (int p = 0; p < 6; ++p) {
+        for (int c = 0; c < 4; ++c)
+            in.planes[p][c] = frustum.planes[p][c];
+        for (int c = 0; c < 3; ++c)
+            in.absPlanes[p][c] = std::fabs(frustum.planes[p][c]);
+    }
+
+#ifdef CUBEY_X86
+    switch (supportedCullKernel(kernel)) {
+    case CullKernel::Avx: return cullAvx(in, visible);
+    case CullKernel::Sse: return cullSse(in, visible);
+    default: break;
+    }
+#endif
+    return cullScalar(in, 0, visible, 0);
+}
+
+size_t FrustumCuller::cull(const Frustum& frustum, uint32_t* visible, CullKernel kernel) const {
+    return cullRange(frustum, visible, kernel, 0, boxCount());
+}
+
+size_t FrustumCuller::cull(const Frustum& frustum, uint32_t* visible, CullKernel kernel, JobSystem& jobs) const {
+    const size_t count = boxCount();
+    size_t batches = std::min<size_t>(count / CullBatchSize, jobs.threadCount() * JobSystem::BatchesPerThread);
+    if (jobs.threadCount() < 2 || batches < 2)
+        return cull(frustum, visible, kernel);
+
+    // Each batch writes its indices where its boxes start in visible, then they are moved together.
+    // Batches start on multiples of 8 so the SIMD kernels only do scalar work at the very end.
+    std::vector<size_t> firsts(batches + 1), visibleCounts(batches);
+    for (size_t b = 0; b < batches; ++b)
+        firsts[b] = count * b / batches & ~(size_t)7;
+    firsts[batches] = count;
+    jobs.wait(jobs.parallelFor(batches, 1, [&](size_t begin, size_t end) {
+        for (size_t b = begin; b < end; ++b)
+            visibleCounts[b] = cullRange(frustum, visible + firsts[b], kernel, firsts[b], firsts[b + 1] - firsts[b]);
+    }));
+    size_t visibleCount = visibleCounts[0];
+    for (size_t b = 1; b < batches; ++b) {
+        std::memmove(visible + visibleCount, visible + firsts[b], visibleCounts[b] * sizeof(uint32_t));
+        visibleCount += visibleCounts[b];
+    }
+    return visibleCount;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "JobSystem.h"
+
+// --- Frustum culling ---
+// Tests axis-aligned bounding boxes against the six planes of a view-projection matrix and lists
+// the boxes that may be visible. The boxes are stored as separate arrays of center and half-size
+// components, so the SSE and AVX kernels test four or eight boxes per instruction. The kernel is
+// picked at runtime from what the CPU supports, with a scalar one for everything else.
+
+// Planes as (normal, distance) with normals pointing inwards: p is inside when dot(normal, p) + distance >= 0
+struct Frustum {
+    glm::vec4 planes[6]; // Left, right, bottom, top, near, far
+};
+
+// The clip volume of viewProjection, in the space the matrix maps from
+Frustum extractFrustum(const glm::mat4& viewProjection);
+
+enum class CullKernel {
+    Scalar,
+    Sse,    // Four boxes at a time
+    Avx     // Eight boxes at a time
+};
+const char* cullKernelName(CullKernel kernel);
+// The widest kernel this CPU supports
+CullKernel bestCullKernel();
+// kernel, or the best supported one if the CPU lacks it
+CullKernel supportedCullKernel(CullKernel kernel);
+
+class FrustumCuller {
+public:
+    // Fewest boxes the threaded cull() gives a batch
+    static const size_t CullBatchSize = 16 * 1024;
+
+    void clear();
+    void reserve(size_t boxes);
+    void addBox(const glm::vec3& center, const glm::vec3& halfSize);
+    size_t boxCount() const { return centerX.size(); }
+    glm::vec3 center(size_t box) const { return glm::vec3(centerX[box], centerY[box], centerZ[box]); }
+    glm::vec3 halfSize(size_t box) const { return glm::vec3(halfX[box], halfY[box], halfZ[box]); }
+
+    // Write the indices of the boxes that intersect frustum to visible, in ascending order, and return
+    // how many there are. visible must have room for boxCount() indices.
+    // Boxes that straddle a plane's line outside the frustum's corners are kept, as with any plane test.
+    size_t cull(const Frustum& frustum, uint32_t* visible, CullKernel kernel) const;
+    // The same in batches of at least CullBatchSize boxes spread over jobs' threads, with the same result
+    size_t cull(const Frustum& frustum, uint32_t* visible, CullKernel kernel, JobSystem& jobs) const;
+
+private:
+    // Cull boxes [first, first + count), writing their indices from visible[0] on
+    size_t cullRange(const Frustum& frustum, uint32_t* visible, CullKernel kernel, size_t first, size_t count) const;
+
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> halfX, halfY, halfZ;
+};
@@ -0,0 +1,287 @@
+#include "GlState.h"
+
+#include <iostream>
+#include <iterator>
+
+// Tokens of OpenGL 4.0 and 4.3 (ARB_draw_indirect, ARB_shader_storage_buffer_object)
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_DRAW_INDIRECT_BUFFER_BINDING 0x8F43
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_SHADER_STORAGE_BUFFER_BINDING 0x90D3
+
+GlStateCache glState;
+
+namespace {
+    // The shadowed targets and capabilities, in slot order, with what glGet* reads them back with
+    struct Target {
+        GLenum target;
+        GLenum binding;
+    };
+    const Target textureTargets[] = {
+        { GL_TEXTURE_2D, GL_TEXTURE_BINDING_2D },
+        { GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BINDING_2D_ARRAY },
+        { GL_TEXTURE_BUFFER, GL_TEXTURE_BINDING_BUFFER },
+        { GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BINDING_CUBE_MAP },
+        { GL_TEXTURE_3D, GL_TEXTURE_BINDING_3D },
+        { GL_TEXTURE_RECTANGLE, GL_TEXTURE_BINDING_RECTANGLE },
+    };
+    const Target bufferTargets[] = {
+        { GL_ARRAY_BUFFER, GL_ARRAY_BUFFER_BINDING },
+        { GL_COPY_READ_BUFFER, GL_COPY_READ_BUFFER },
+        { GL_COPY_WRITE_BUFFER, GL_COPY_WRITE_BUFFER },
+        { GL_DRAW_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER_BINDING },
+        { GL_PIXEL_PACK_BUFFER, GL_PIXEL_PACK_BUFFER_BINDING },
+        { GL_PIXEL_UNPACK_BUFFER, GL_PIXEL_UNPACK_BUFFER_BINDING },
+        { GL_SHADER_STORAGE_BUFFER, GL_SHADER_STORAGE_BUFFER_BINDING },
+        { GL_TEXTURE_BUFFER, GL_TEXTURE_BUFFER },
+        { GL_TRANSFORM_FEEDBACK_BUFFER, GL_TRANSFORM_FEEDBACK_BUFFER_BINDING },
+        { GL_UNIFORM_BUFFER, GL_UNIFORM_BUFFER_BINDING },
+    };
+    const GLenum capabilityNames[] = { GL_BLEND, GL_CULL_FACE, GL_DEPTH_TEST, GL_RASTERIZER_DISCARD, GL_SCISSOR_TEST };
+    const GLenum blendQueries[] = { GL_BLEND_SRC_RGB, GL_BLEND_DST_RGB, GL_BLEND_SRC_ALPHA, GL_BLEND_DST_ALPHA };
+
+    template <size_t N>
+    int findSlot(const Target (&targets)[N], GLenum target) {
+        for (size_t i = 0; i < N; ++i) {
+            if (targets[i].target == target)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    int capabilitySlot(GLenum capability) {
+        for (size_t i = 0; i < std::size(capabilityNames); ++i) {
+            if (capabilityNames[i] == capability)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    GLuint getInteger(GLenum name) {
+        GLint value = 0;
+        glGetIntegerv(name, &value);
+        return (GLuint)value;
+    }
+}
+
+template <typename T, typename Set>
+bool GlStateCache::change(T& slot, T value, Set set) {
+    if (slot == value) {
+        stats.dropped++;
+        return false;
+    }
+    set();
+    slot = value;
+    stats.calls++;
+    return true;
+}
+
+bool GlStateCache::useProgram(GLuint newProgram) {
+    return change(program, newProgram, [&] { glUseProgram(newProgram); });
+}
+
+bool GlStateCache::bindVertexArray(GLuint newVertexArray) {
+    return change(vertexArray, newVertexArray, [&] { glBindVertexArray(newVertexArray); });
+}
+
+void GlStateCache::bindFramebuffer(GLenum target, GLuint framebuffer) {
+    if (target == GL_FRAMEBUFFER) {
+        if (drawFramebuffer == framebuffer && readFramebuffer == framebuffer) {
+            stats.dropped++;
+            return;
+        }
+        glBindFramebuffer(target, framebuffer);
+        drawFramebuffer = readFramebuffer = framebuffer;
+        stats.calls++;
+    } else {
+        change(target == GL_DRAW_FRAMEBUFFER ? drawFramebuffer : readFramebuffer, framebuffer,
+               [&] { glBindFramebuffer(target, framebuffer); });
+    }
+}
+
+void GlStateCache::activeTexture(GLenum unit) {
+    change(activeUnit, (GLuint)(unit - GL_TEXTURE0), [&] { glActiveTexture(unit); });
+}
+
+bool GlStateCache::bindTexture(GLenum target, GLuint texture) {
+    int slot = findSlot(textureTargets, target);
+    if (activeUnit >= (GLuint)TextureUnits || slot < 0) {
+        glBindTexture(target, texture);
+        stats.calls++;
+        return true;
+    }
+    return change(textures[activeUnit][slot], texture, [&] { glBindTexture(target, texture); });
+}
+
+void GlStateCache::bindBuffer(GLenum target, GLuint buffer) {
+    int slot = findSlot(bufferTargets, target);
+    if (slot < 0) {
+        glBindBuffer(target, buffer);
+        stats.calls++;
+        return;
+    }
+    change(buffers[slot], buffer, [&] { glBindBuffer(target, buffer); });
+}
+
+void GlStateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    glBindBufferBase(target, index, buffer);
+    stats.calls++;
+    int slot = findSlot(bufferTargets, target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GlStateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size) {
+    glBindBufferRange(target, index, buffer, offset, size);
+    stats.calls++;
+    int slot = findSlot(bufferTargets, target);
+    if (slot >= 0)
+        buffers[slot] = buffer;
+}
+
+void GlStateCache::enable(GLenum capability) {
+    int slot = capabilitySlot(capability);
+    if (slot < 0) {
+        glEnable(capability);
+        stats.calls++;
+        return;
+    }
+    change(capabilities[slot], (GLuint)GL_TRUE, [&] { glEnable(capability); });
+}
+
+void GlStateCache::disable(GLenum capability) {
+    int slot = capabilitySlot(capability);
+    if (slot < 0) {
+        glDisable(capability);
+        stats.calls++;
+        return;
+    }
+    change(capabilities[slot], (GLuint)GL_FALSE, [&] { glDisable(capability); });
+}
+
+void GlStateCache::blendFunc(GLenum source, GLenum destination) {
+    blendFuncSeparate(source, destination, source, destination);
+}
+
+void GlStateCache::blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb, GLenum sourceAlpha, GLenum destinationAlpha) {
+    if (blend[0] == sourceRgb && blend[1] == destinationRgb && blend[2] == sourceAlpha && blend[3] == destinationAlpha) {
+        stats.dropped++;
+        return;
+    }
+    glBlendFuncSeparate(sourceRgb, destinationRgb, sourceAlpha, destinationAlpha);
+    blend[0] = sourceRgb;
+    blend[1] = destinationRgb;
+    blend[2] = sourceAlpha;
+    blend[3] = destinationAlpha;
+    stats.calls++;
+}
+
+void GlStateCache::deleteProgram(GLuint deleted) {
+    glDeleteProgram(deleted);
+    // A program deleted while in use stays in use until the next glUseProgram
+    if (deleted != 0 && program == deleted)
+        program = Unknown;
+}
+
+void GlStateCache::deleteVertexArrays(GLsizei count, const GLuint* vertexArrays) {
+    glDeleteVertexArrays(count, vertexArrays);
+    for (GLsizei i = 0; i < count; ++i) {
+        if (vertexArrays[i] != 0 && vertexArray == vertexArrays[i])
+            vertexArray = 0;
+    }
+}
+
+void GlStateCache::deleteFramebuffers(GLsizei count, const GLuint* framebuffers) {
+    glDeleteFramebuffers(count, framebuffers);
+    for (GLsizei i = 0; i < count; ++i) {
+        if (framebuffers[i] == 0)
+            continue;
+        if (drawFramebuffer == framebuffers[i])
+            drawFramebuffer = 0;
+        if (readFramebuffer == framebuffers[i])
+            readFramebuffer = 0;
+    }
+}
+
+void GlStateCache::deleteTextures(GLsizei count, const GLuint* deleted) {
+    glDeleteTextures(count, deleted);
+    for (GLsizei i = 0; i < count; ++i) {
+        if (deleted[i] == 0)
+            continue;
+        for (auto& unit : textures) {
+            for (GLuint& texture : unit) {
+                if (texture == deleted[i])
+                    texture = 0;
+            }
+        }
+    }
+}
+
+void GlStateCache::deleteBuffers(GLsizei count, const GLuint* deleted) {
+    glDeleteBuffers(count, deleted);
+    for (GLsizei i = 0; i < count; ++i) {
+        if (deleted[i] == 0)
+            continue;
+        for (GLuint& buffer : buffers) {
+            if (buffer == deleted[i])
+                buffer = 0;
+        }
+    }
+}
+
+void GlStateCache::invalidate() {
+    program = vertexArray = drawFramebuffer = readFramebuffer = activeUnit = Unknown;
+    for (auto& unit : textures) {
+        for (GLuint& texture : unit)
+            texture = Unknown;
+    }
+    for (GLuint& buffer : buffers)
+        buffer = Unknown;
+    for (GLuint& capability : capabilities)
+        capability = Unknown;
+    for (GLuint& factor : blend)
+        factor = Unknown;
+}
+
+bool GlStateCache::verify(const char* where) {
+    if (!verification)
+        return true;
+    bool matched = true;
+    // Slots still unknown are skipped: nothing was assumed about them, and some targets belong to
+    // GL versions the context may not have
+    auto check = [&](GLuint& slot, GLuint actual, const char* what, int index) {
+        if (slot == Unknown || slot == actual)
+            return;
+        std::cerr << "GL state cache, " << where << ": " << what;
+        if (index >= 0)
+            std::cerr << " " << index;
+        std::cerr << " is " << actual << ", expected " << slot << std::endl;
+        slot = actual;
+        matched = false;
+    };
+    check(program, getInteger(GL_CURRENT_PROGRAM), "program", -1);
+    check(vertexArray, getInteger(GL_VERTEX_ARRAY_BINDING), "vertex array", -1);
+    check(drawFramebuffer, getInteger(GL_DRAW_FRAMEBUFFER_BINDING), "draw framebuffer", -1);
+    check(readFramebuffer, getInteger(GL_READ_FRAMEBUFFER_BINDING), "read framebuffer", -1);
+    GLuint actualUnit = getInteger(GL_ACTIVE_TEXTURE) - GL_TEXTURE0;
+    check(activeUnit, actualUnit, "active texture unit", -1);
+    for (int unit = 0; unit < TextureUnits; ++unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        for (int slot = 0; slot < TextureTargets; ++slot)
+            check(textures[unit][slot], getInteger(textureTargets[slot].binding), "texture on unit", unit);
+    }
+    glActiveTexture(GL_TEXTURE0 + actualUnit);
+    for (int slot = 0; slot < BufferTargets; ++slot)
+        check(buffers[slot], getInteger(bufferTargets[slot].binding), "buffer target", slot);
+    for (int slot = 0; slot < Capabilities; ++slot)
+        check(capabilities[slot], glIsEnabled(capabilityNames[slot]) ? GL_TRUE : GL_FALSE, "capability", slot);
+    for (int factor = 0; factor < 4; ++factor)
+        check(blend[factor], getInteger(blendQueries[factor]), "blend factor", factor);
+    return matched;
+}
+
+GlStateStats GlStateCache::resetStats() {
+    GlStateStats result = stats;
+    stats = GlStateStats();
+    return result;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// --- GL state cache ---
+// A thin layer between the app and glad that shadows the state the frame changes most: the program,
+// the vertex array, the framebuffers, the active texture unit and the textures bound to each unit,
+// the buffer bound to each generic target, the blend function and a few capabilities. A call that
+// would set what is already set is dropped, so code can bind what it needs without knowing what the
+// code before it left bound, and needn't unbind afterwards. On drivers that do all their work on the
+// CPU, such as llvmpipe, every dropped call is time saved.
+// Everything that changes this state has to go through the cache, deletes included, or call
+// invalidate() after changing it directly. Targets and capabilities the cache doesn't shadow, and
+// GL_ELEMENT_ARRAY_BUFFER, which belongs to the bound vertex array, are passed straight on.
+// With verification on, verify() reads the real state back with glGet* and reports where the shadow
+// went wrong: a sign that something changed the state behind the cache's back.
+
+struct GlStateStats {
+    int calls = 0;   // Passed on to GL
+    int dropped = 0; // Already set
+};
+
+class GlStateCache {
+public:
+    static const int TextureUnits = 16;
+
+    GlStateCache() { invalidate(); }
+
+    // The binds return true when the call went on to GL, false when it was dropped
+    bool useProgram(GLuint program);
+    bool bindVertexArray(GLuint vertexArray);
+    // GL_FRAMEBUFFER binds both the draw and the read framebuffer
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    void activeTexture(GLenum unit);
+    // To the active unit
+    bool bindTexture(GLenum target, GLuint texture);
+    void bindBuffer(GLenum target, GLuint buffer);
+    // Indexed bindings are passed on, as they change offsets every frame, but they bind the generic target too
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void blendFunc(GLenum source, GLenum destination);
+    void blendFuncSeparate(GLenum sourceRgb, GLenum destinationRgb, GLenum sourceAlpha, GLenum destinationAlpha);
+
+    // Deleting an object unbinds it, and its name can come back from the next glGen*
+    void deleteProgram(GLuint program);
+    void deleteVertexArrays(GLsizei count, const GLuint* vertexArrays);
+    void deleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+    void deleteTextures(GLsizei count, const GLuint* textures);
+    void deleteBuffers(GLsizei count, const GLuint* buffers);
+
+    // Forget everything, so the next call of each kind goes through. For a new context, or after
+    // changing the state directly.
+    void invalidate();
+
+    void setVerification(bool enabled) { verification = enabled; }
+    bool verifying() const { return verification; }
+    // With verification on, compare the shadow with what glGet* returns, report each difference with
+    // where, and take GL's value. Returns false if anything differed.
+    bool verify(const char* where);
+
+    // Return the counters gathered since the previous call and start counting again
+    GlStateStats resetStats();
+
+private:
+    static const GLuint Unknown = ~0u;
+    static const int TextureTargets = 6;
+    static const int BufferTargets = 10;
+    static const int Capabilities = 5;
+
+    // Call set with the new value unless slot already holds it. Returns whether it did.
+    template <typename T, typename Set>
+    bool change(T& slot, T value, Set set);
+
+    GLuint program = Unknown;
+    GLuint vertexArray = Unknown;
+    GLuint drawFramebuffer = Unknown, readFramebuffer = Unknown;
+    GLuint activeUnit = Unknown; // 0 for GL_TEXTURE0
+    GLuint textures[TextureUnits][TextureTargets];
+    GLuint buffers[BufferTargets];
+    GLuint capabilities[Capabilities]; // GL_TRUE, GL_FALSE or Unknown
+    GLuint blend[4];                   // Source and destination RGB, then alpha
+
+    bool verification = false;
+    GlStateStats stats;
+};
+
+// The cache of the app's one context. Only the thread the context is current on may use it.
+extern GlStateCache glState;
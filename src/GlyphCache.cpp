@@ -0,0 +1,475 @@
+#include "GlyphCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "FontAtlasFile.h"
+#include "GlState.h"
+
+namespace {
+    // Empty texels kept right of and below every glyph so linear filtering never bleeds into a neighbour
+    const int GlyphPadding = 1;
+    // Shelf heights are rounded up to this so glyphs of similar height share shelves
+    const int ShelfGranularity = 8;
+    // Past this many dirty rectangles a single bounding upload is cheaper than many small ones
+    const size_t MaxDirtyRects = 16;
+
+    int shelfHeightFor(int h) {
+        return (h + ShelfGranularity - 1) / ShelfGranularity * ShelfGranularity;
+    }
+}
+
+bool GlyphCache::init(const unsigned char* ttfData, float pixelHeight, size_t atlasBudgetBytes, GlyphRaster raster) {
+    if (!initFont(ttfData, pixelHeight))
+        return false;
+    rasterMode = raster;
+
+    // Pick the largest power-of-two atlas (one byte per texel) that fits the budget
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    width = height = 64;
+    while ((size_t)width * height * 2 <= atlasBudgetBytes) {
+        if (width == height) {
+            if (width * 2 > maxTextureSize) break;
+            width *= 2;
+        } else {
+            height *= 2;
+        }
+    }
+
+    resetState();
+    pixels.assign((size_t)width * height, 0);
+    createTextures(nullptr, 0);
+
+    std::cout << (raster == GlyphRaster::SignedDistance ? "SDF glyph cache atlas: " : "Glyph cache atlas: ") << width << "x" << height << " (" << (width * height / 1024) << " KB)" << std::endl;
+    return true;
+}
+
+bool GlyphCache::initCooked(const void* atlasFile, size_t atlasFileSize, FontLoader loadFont) {
+    const FontAtlasHeader* header = validateFontAtlas(atlasFile, atlasFileSize);
+    if (!header) {
+        std::cerr << "Font atlas file is malformed or from another version" << std::endl;
+        return false;
+    }
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    if ((GLint)header->atlasWidth > maxTextureSize || (GLint)header->atlasHeight > maxTextureSize || header->glyphCount > MaxSlots) {
+        std::cerr << "Font atlas file is too large: " << header->atlasWidth << "x" << header->atlasHeight << ", " << header->glyphCount << " glyphs" << std::endl;
+        return false;
+    }
+
+    hasFont = false;
+    fontLoader = loadFont;
+    rasterPixelHeight = header->pixelHeight;
+    rasterMode = (GlyphRaster)header->raster;
+    width = (int)header->atlasWidth;
+    height = (int)header->atlasHeight;
+
+    resetState();
+    pixels.clear(); // Allocated with the font, if a codepoint ever misses
+    shelvesTop = (int)header->usedHeight;
+    createTextures(fontAtlasPixels(header), shelvesTop);
+
+    const FontAtlasGlyph* cookedGlyphs = fontAtlasGlyphs(header);
+    for (uint32_t i = 0; i < header->glyphCount; ++i) {
+        const FontAtlasGlyph& cooked = cookedGlyphs[i];
+        if (cooked.x1 > width || cooked.y1 > shelvesTop)
+            continue;
+        Entry entry;
+        entry.codepoint = cooked.codepoint;
+        entry.slot = freeSlots.back();
+        entry.x0 = cooked.x0;
+        entry.y0 = cooked.y0;
+        entry.x1 = cooked.x1;
+        entry.y1 = cooked.y1;
+        entry.xoff = cooked.xoff;
+        entry.yoff = cooked.yoff;
+        entry.xadvance = cooked.xadvance;
+        entry.shelf = -1;
+        entry.cooked = true;
+        if (glyphs.emplace(cooked.codepoint, entry).second) {
+            freeSlots.pop_back();
+            setSlotMetrics(entry);
+        }
+    }
+
+    std::cout << (rasterMode == GlyphRaster::SignedDistance ? "SDF glyph cache atlas: " : "Glyph cache atlas: ") << width << "x" << height
+              << " (" << (width * height / 1024) << " KB), " << glyphs.size() << " cooked glyphs" << std::endl;
+    return true;
+}
+
+bool GlyphCache::initFont(const unsigned char* ttfData, float pixelHeight) {
+    if (!stbtt_InitFont(&font, ttfData, stbtt_GetFontOffsetForIndex(ttfData, 0))) {
+        std::cerr << "Failed to parse font for glyph cache" << std::endl;
+        return false;
+    }
+    hasFont = true;
+    scale = stbtt_ScaleForPixelHeight(&font, pixelHeight);
+    rasterPixelHeight = pixelHeight;
+    return true;
+}
+
+bool GlyphCache::loadFallbackFont() {
+    if (!fontLoader)
+        return false;
+    const unsigned char* ttfData = fontLoader();
+    fontLoader = nullptr;
+    // At the size the cooked glyphs were rasterized at, so both kinds scale alike
+    if (!ttfData || !initFont(ttfData, rasterPixelHeight))
+        return false;
+    pixels.assign((size_t)width * height, 0);
+    return true;
+}
+
+void GlyphCache::resetState() {
+    shelves.clear();
+    shelvesTop = 0;
+    glyphs.clear();
+    lru.clear();
+    dirtyRects.clear();
+    freeSlots.clear();
+    for (int slot = MaxSlots - 1; slot >= 0; --slot)
+        freeSlots.push_back((uint16_t)slot);
+    slotMetrics.assign(MaxSlots * 8, 0.0f);
+    dirtySlotMin = MaxSlots;
+    dirtySlotMax = -1;
+    stats = GlyphCacheStats();
+}
+
+// Create the atlas texture, filled from the CPU copy, or with cookedRows rows of cooked pixels above empty ones
+void GlyphCache::createTextures(const unsigned char* cookedPixels, int cookedRows) {
+    glGenTextures(1, &atlasTexture);
+    glState.bindTexture(GL_TEXTURE_2D, atlasTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (cookedPixels) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+        if (cookedRows > 0)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, cookedRows, GL_RED, GL_UNSIGNED_BYTE, cookedPixels);
+        if (cookedRows < height) {
+            // Runtime glyphs only upload their own cells, so the free rows must start out empty
+            std::vector<unsigned char> empty((size_t)width * (height - cookedRows), 0);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, cookedRows, width, height - cookedRows, GL_RED, GL_UNSIGNED_BYTE, empty.data());
+        }
+    } else {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, width, height, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glState.bindTexture(GL_TEXTURE_2D, 0);
+
+    // Glyph metrics for the instanced text path, two RGBA32F texels per slot
+    glGenBuffers(1, &metricsBuffer);
+    glState.bindBuffer(GL_TEXTURE_BUFFER, metricsBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, slotMetrics.size() * sizeof(float), slotMetrics.data(), GL_DYNAMIC_DRAW);
+    glGenTextures(1, &metricsBufferTexture);
+    glState.bindTexture(GL_TEXTURE_BUFFER, metricsBufferTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, metricsBuffer);
+    glState.bindTexture(GL_TEXTURE_BUFFER, 0);
+    glState.bindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void GlyphCache::destroy() {
+    glState.deleteTextures(1, &atlasTexture);
+    glState.deleteTextures(1, &metricsBufferTexture);
+    glState.deleteBuffers(1, &metricsBuffer);
+    atlasTexture = metricsBufferTexture = metricsBuffer = 0;
+}
+
+void GlyphCache::beginFrame() {
+    frame++;
+}
+
+const CachedGlyph* GlyphCache::get(uint32_t codepoint) {
+    auto found = glyphs.find(codepoint);
+    if (found != glyphs.end()) {
+        Entry& entry = found->second;
+        entry.lastUsedFrame = frame;
+        if (!entry.cooked)
+            lru.splice(lru.begin(), lru, entry.lruPosition);
+        stats.hits++;
+        return &entry;
+    }
+    stats.misses++;
+
+    if (!hasFont && !loadFallbackFont()) {
+        failures++;
+        stats.failed++;
+        return nullptr;
+    }
+    int glyphIndex = stbtt_FindGlyphIndex(&font, (int)codepoint); // 0 (.notdef) for missing codepoints
+    rasterizeGlyph(font, scale, rasterMode, glyphIndex, rasterized);
+    int glyphWidth = rasterized.width, glyphHeight = rasterized.height;
+    bool hasPixels = glyphWidth > 0 && glyphHeight > 0;
+
+    bool placed = true;
+    if (hasPixels && (glyphWidth + GlyphPadding > width || shelfHeightFor(glyphHeight + GlyphPadding) > height - shelvesTop))
+        placed = false;
+    if (placed && freeSlots.empty() && !evictLeastRecentlyUsed())
+        placed = false;
+
+    int x = 0, y = 0, shelf = -1;
+    if (placed && hasPixels) {
+        while (placed && !allocate(glyphWidth + GlyphPadding, glyphHeight + GlyphPadding, x, y, shelf))
+            placed = evictLeastRecentlyUsed();
+    }
+    if (!placed) {
+        failures++;
+        stats.failed++;
+        return nullptr;
+    }
+
+    if (hasPixels) {
+        // Clear the padded cell, which may hold an evicted glyph, then copy the glyph into it
+        for (int row = 0; row < glyphHeight + GlyphPadding; ++row)
+            std::fill_n(&pixels[(size_t)(y + row) * width + x], glyphWidth + GlyphPadding, 0);
+        for (int row = 0; row < glyphHeight; ++row)
+            std::copy_n(&rasterized.pixels[(size_t)row * glyphWidth], glyphWidth, &pixels[(size_t)(y + row) * width + x]);
+        dirtyRects.push_back({ x, y, x + glyphWidth + GlyphPadding, y + glyphHeight + GlyphPadding });
+    }
+
+    Entry entry;
+    entry.codepoint = codepoint;
+    entry.slot = freeSlots.back();
+    freeSlots.pop_back();
+    entry.x0 = x;
+    entry.y0 = y;
+    entry.x1 = x + glyphWidth;
+    entry.y1 = y + glyphHeight;
+    entry.xoff = (float)rasterized.xoff;
+    entry.yoff = (float)rasterized.yoff;
+    entry.xadvance = rasterized.xadvance;
+    entry.lastUsedFrame = frame;
+    entry.shelf = hasPixels ? shelf : -1;
+    lru.push_front(codepoint);
+    entry.lruPosition = lru.begin();
+
+    const CachedGlyph& glyph = glyphs.emplace(codepoint, entry).first->second;
+    setSlotMetrics(glyph);
+    return &glyph;
+}
+
+void GlyphCache::setSlotMetrics(const CachedGlyph& glyph) {
+    float* metrics = &slotMetrics[(size_t)glyph.slot * 8];
+    metrics[0] = (float)glyph.x0;
+    metrics[1] = (float)glyph.y0;
+    metrics[2] = (float)glyph.x1;
+    metrics[3] = (float)glyph.y1;
+    metrics[4] = glyph.xoff;
+    metrics[5] = glyph.yoff;
+    metrics[6] = glyph.xadvance;
+    metrics[7] = 0.0f;
+    dirtySlotMin = std::min(dirtySlotMin, (int)glyph.slot);
+    dirtySlotMax = std::max(dirtySlotMax, (int)glyph.slot);
+}
+
+void GlyphCache::touch(const CachedGlyph* glyph) {
+    // Every CachedGlyph handed out is the base of an Entry owned by this cache
+    Entry* entry = static_cast<Entry*>(const_cast<CachedGlyph*>(glyph));
+    if (entry->lastUsedFrame != frame) {
+        entry->lastUsedFrame = frame;
+        if (!entry->cooked)
+            lru.splice(lru.begin(), lru, entry->lruPosition);
+    }
+    stats.hits++;
+}
+
+void GlyphCache::flushUploads() {
+    if (!dirtyRects.empty()) {
+        if (dirtyRects.size() > MaxDirtyRects) {
+            Rect bounds = dirtyRects[0];
+            for (const Rect& r : dirtyRects) {
+                bounds.x0 = std::min(bounds.x0, r.x0);
+                bounds.y0 = std::min(bounds.y0, r.y0);
+                bounds.x1 = std::max(bounds.x1, r.x1);
+                bounds.y1 = std::max(bounds.y1, r.y1);
+            }
+            dirtyRects.assign(1, bounds);
+        }
+
+        glState.bindTexture(GL_TEXTURE_2D, atlasTexture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+        for (const Rect& r : dirtyRects) {
+            glPixelStorei(GL_UNPACK_SKIP_PIXELS, r.x0);
+            glPixelStorei(GL_UNPACK_SKIP_ROWS, r.y0);
+            glTexSubImage2D(GL_TEXTURE_2D, 0, r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+            stats.uploads++;
+            stats.bytesUploaded += (size_t)(r.x1 - r.x0) * (r.y1 - r.y0);
+        }
+        // Restore the defaults the rest of the app expects
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        dirtyRects.clear();
+    }
+
+    if (dirtySlotMax >= dirtySlotMin) {
+        GLintptr offset = (GLintptr)dirtySlotMin * 8 * sizeof(float);
+        GLsizeiptr bytes = (GLsizeiptr)(dirtySlotMax - dirtySlotMin + 1) * 8 * sizeof(float);
+        glState.bindBuffer(GL_TEXTURE_BUFFER, metricsBuffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, offset, bytes, &slotMetrics[(size_t)dirtySlotMin * 8]);
+        stats.bytesUploaded += bytes;
+        dirtySlotMin = MaxSlots;
+        dirtySlotMax = -1;
+    }
+}
+
+GlyphCacheStats GlyphCache::resetStats() {
+    GlyphCacheStats result = stats;
+    stats = GlyphCacheStats();
+    return result;
+}
+
+// Find room for a w x h cell (padding included). Prefers shelves of the matching height class,
+// then opens a new shelf, and only then spills onto taller shelves.
+bool GlyphCache::allocate(int w, int h, int& outX, int& outY, int& outShelf) {
+    int shelfHeight = shelfHeightFor(h);
+
+    for (size_t i = 0; i < shelves.size(); ++i) {
+        if (shelves[i].height == shelfHeight && allocateOnShelf(shelves[i], w, outX)) {
+            outY = shelves[i].y;
+            outShelf = (int)i;
+            return true;
+        }
+    }
+
+    int nextY = shelves.empty() ? shelvesTop : shelves.back().y + shelves.back().height;
+    if (nextY + shelfHeight <= height) {
+        Shelf shelf;
+        shelf.y = nextY;
+        shelf.height = shelfHeight;
+        shelves.push_back(shelf);
+        allocateOnShelf(shelves.back(), w, outX);
+        outY = nextY;
+        outShelf = (int)shelves.size() - 1;
+        return true;
+    }
+
+    for (size_t i = 0; i < shelves.size(); ++i) {
+        if (shelves[i].height > shelfHeight && allocateOnShelf(shelves[i], w, outX)) {
+            outY = shelves[i].y;
+            outShelf = (int)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool GlyphCache::allocateOnShelf(Shelf& shelf, int w, int& outX) {
+    // First fit into a hole left by an evicted glyph
+    for (size_t i = 0; i < shelf.freeSpans.size(); ++i) {
+        Span& span = shelf.freeSpans[i];
+        if (span.width >= w) {
+            outX = span.x;
+            span.x += w;
+            span.width -= w;
+            if (span.width == 0)
+                shelf.freeSpans.erase(shelf.freeSpans.begin() + i);
+            return true;
+        }
+    }
+    if (shelf.cursorX + w <= width) {
+        outX = shelf.cursorX;
+        shelf.cursorX += w;
+        return true;
+    }
+    return false;
+}
+
+// Evict the least recently used glyph. Fails when every cached glyph was used this frame.
+bool GlyphCache::evictLeastRecentlyUsed() {
+    if (lru.empty())
+        return false;
+    auto found = glyphs.find(lru.back());
+    Entry& entry = found->second;
+    if (entry.lastUsedFrame == frame)
+        return false;
+
+    if (entry.shelf >= 0) {
+        releaseSpan(shelves[entry.shelf], entry.x0, entry.x1 - entry.x0 + GlyphPadding);
+        // Give the vertical space of empty trailing shelves back so it can be re-shelved at any height
+        while (!shelves.empty() && shelves.back().cursorX == 0)
+            shelves.pop_back();
+    }
+    freeSlots.push_back(entry.slot);
+    lru.pop_back();
+    glyphs.erase(found);
+    evictions++;
+    stats.evictions++;
+    return true;
+}
+
+void GlyphCache::releaseSpan(Shelf& shelf, int x, int w) {
+    auto position = std::lower_bound(shelf.freeSpans.begin(), shelf.freeSpans.end(), x,
+        [](const Span& span, int value) { return span.x < value; });
+    position = shelf.freeSpans.insert(position, { x, w });
+
+    // Merge with the following and preceding holes
+    auto next = position + 1;
+    if (next != shelf.freeSpans.end() && position->x + position->width == next->x) {
+        position->width += next->width;
+        shelf.freeSpans.erase(next);
+    }
+    if (position != shelf.freeSpans.begin()) {
+        auto previous = position - 1;
+        if (previous->x + previous->width == position->x) {
+            previous->width += position->width;
+            position = shelf.freeSpans.erase(position) - 1;
+        }
+    }
+
+    // A hole touching the cursor just moves the cursor back
+    if (position->x + position->width == shelf.cursorX) {
+        shelf.cursorX = position->x;
+        shelf.freeSpans.erase(position);
+    }
+}
+
+uint32_t nextCodepoint(const std::string& text, size_t& i) {
+    const uint32_t Replacement = 0xFFFD;
+    unsigned char lead = (unsigned char)text[i];
+    int length;
+    uint32_t codepoint;
+    if (lead < 0x80) {
+        i++;
+        return lead;
+    } else if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        codepoint = lead & 0x07;
+    } else {
+        i++;
+        return Replacement;
+    }
+
+    if (i + length > text.size()) {
+        i++;
+        return Replacement;
+    }
+    for (int k = 1; k < length; ++k) {
+        unsigned char continuation = (unsigned char)text[i + k];
+        if ((continuation & 0xC0) != 0x80) {
+            i++;
+            return Replacement;
+        }
+        codepoint = (codepoint << 6) | (continuation & 0x3F);
+    }
+
+    // Reject overlong encodings, surrogates and values past the Unicode range
+    static const uint32_t minimumForLength[5] = { 0, 0, 0x80, 0x800, 0x10000 };
+    if (codepoint < minimumForLength[length] || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF) {
+        i++;
+        return Replacement;
+    }
+    i += length;
+    return codepoint;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GlyphRaster.h"
+#include "stb_truetype.h"
+
+// --- Dynamic glyph cache ---
+// Rasterizes codepoints with stb_truetype the first time they are drawn and packs them into a
+// single-channel atlas texture using a shelf allocator. Only the rectangles that changed are
+// uploaded. When the atlas is full, the least recently used glyphs are evicted to make room.
+// Glyphs touched during the current frame are never evicted, so a frame's batch stays valid.
+// The cache can also start from a cooked atlas (see FontAtlasFile.h), whose glyphs stay resident;
+// codepoints the file lacks are rasterized into the free rows below the cooked ones.
+
+// Placement and metrics of one cached glyph, all in atlas pixels
+struct CachedGlyph {
+    uint32_t codepoint = 0;
+    uint16_t slot = 0;           // Stable index for the lifetime of the glyph, used by the instanced text path
+    int x0 = 0, y0 = 0;          // Top-left corner in the atlas
+    int x1 = 0, y1 = 0;          // Bottom-right corner in the atlas (exclusive)
+    float xoff = 0.0f, yoff = 0.0f; // Offset from the pen position to the top-left of the quad
+    float xadvance = 0.0f;       // How far to move the pen after this glyph
+    uint64_t lastUsedFrame = 0;
+};
+
+struct GlyphCacheStats {
+    int hits = 0;
+    int misses = 0;           // Glyphs rasterized
+    int evictions = 0;
+    int failed = 0;           // Glyphs that could not be placed even after evicting
+    int uploads = 0;          // glTexSubImage2D calls
+    size_t bytesUploaded = 0;
+};
+
+class GlyphCache {
+public:
+    static const int MaxSlots = 4096;
+
+    // Takes ownership of nothing: ttfData must outlive the cache.
+    // atlasBudgetBytes is rounded down to the largest power-of-two atlas (one byte per texel) that fits.
+    bool init(const unsigned char* ttfData, float pixelHeight, size_t atlasBudgetBytes, GlyphRaster raster = GlyphRaster::Coverage);
+    // Returns the TTF for a cooked cache to rasterize missing codepoints from, or nullptr if there is none
+    using FontLoader = const unsigned char* (*)();
+
+    // Start from a cooked atlas file, uploading its pixels as they are. Its glyphs are never evicted.
+    // The first codepoint missing from the file calls loadFont, and from then on missing codepoints
+    // are rasterized below the cooked rows like in any other cache; without a font they fail.
+    // atlasFile only has to live during the call, the font as long as the cache.
+    bool initCooked(const void* atlasFile, size_t atlasFileSize, FontLoader loadFont = nullptr);
+    void destroy();
+
+    // Call once per frame before any lookups. Glyphs used after this call are pinned until the next one.
+    void beginFrame();
+
+    // Look up a codepoint, rasterizing it on a miss. Returns nullptr if it could not be placed.
+    const CachedGlyph* get(uint32_t codepoint);
+
+    // Mark a glyph returned by get() as used this frame without looking it up again.
+    // Only valid while evictionCount() hasn't changed since the glyph was returned.
+    void touch(const CachedGlyph* glyph);
+
+    // Total glyphs evicted so far. Callers holding on to CachedGlyph pointers compare this to
+    // tell whether those pointers might be stale.
+    uint64_t evictionCount() const { return evictions; }
+    // Total lookups that returned nullptr so far
+    uint64_t failureCount() const { return failures; }
+
+    // Upload the dirty atlas rectangles and new glyph metrics. Call before drawing with the atlas.
+    void flushUploads();
+
+    GLuint texture() const { return atlasTexture; }
+    GLuint metricsTexture() const { return metricsBufferTexture; }
+    int atlasWidth() const { return width; }
+    int atlasHeight() const { return height; }
+    float pixelHeight() const { return rasterPixelHeight; }
+    GlyphRaster raster() const { return rasterMode; }
+    size_t glyphCount() const { return glyphs.size(); }
+
+    // Return the counters gathered since the previous call and start counting again
+    GlyphCacheStats resetStats();
+
+private:
+    struct Span {
+        int x, width;
+    };
+    struct Shelf {
+        int y, height;
+        int cursorX = 0;              // Everything right of this is unused
+        std::vector<Span> freeSpans;  // Holes left by evicted glyphs, sorted by x
+    };
+    struct Rect {
+        int x0, y0, x1, y1;
+    };
+    struct Entry : CachedGlyph {
+        int shelf;
+        bool cooked = false;                      // Loaded from an atlas file, resident and not in the LRU list
+        std::list<uint32_t>::iterator lruPosition;
+    };
+
+    bool initFont(const unsigned char* ttfData, float pixelHeight);
+    // Load the font of a cooked cache on its first miss. Returns whether there is a font to rasterize with.
+    bool loadFallbackFont();
+    void resetState();
+    void createTextures(const unsigned char* cookedPixels, int cookedRows);
+    void setSlotMetrics(const CachedGlyph& glyph);
+    bool allocate(int w, int h, int& outX, int& outY, int& outShelf);
+    bool allocateOnShelf(Shelf& shelf, int w, int& outX);
+    bool evictLeastRecentlyUsed();
+    void releaseSpan(Shelf& shelf, int x, int w);
+
+    stbtt_fontinfo font;
+    bool hasFont = false;
+    FontLoader fontLoader = nullptr;          // Cleared once called, so a missing font is only looked for once
+    float scale = 1.0f;
+    float rasterPixelHeight = 0.0f;
+    GlyphRaster rasterMode = GlyphRaster::Coverage;
+    int width = 0, height = 0;
+
+    std::vector<unsigned char> pixels;        // CPU copy of the atlas, only of runtime-rasterized glyphs, empty until there is a font
+    std::vector<Shelf> shelves;
+    int shelvesTop = 0;                       // Rows above this hold cooked glyphs
+    std::unordered_map<uint32_t, Entry> glyphs;
+    std::list<uint32_t> lru;                  // Most recently used at the front
+    std::vector<uint16_t> freeSlots;
+    std::vector<Rect> dirtyRects;
+    RasterizedGlyph rasterized;               // Scratch space reused by every miss
+    std::vector<float> slotMetrics;           // CPU copy of the metrics buffer, 8 floats per slot
+    int dirtySlotMin = MaxSlots, dirtySlotMax = -1;
+    uint64_t frame = 1;
+    uint64_t evictions = 0;
+    uint64_t failures = 0;
+    GlyphCacheStats stats;
+
+    GLuint atlasTexture = 0;
+    GLuint metricsBuffer = 0, metricsBufferTexture = 0;
+};
+
+// Decode the UTF-8 sequence starting at text[i] and advance i past it.
+// Malformed sequences decode to U+FFFD and consume one byte.
+uint32_t nextCodepoint(const std::string& text, size_t& i);
@@ -0,0 +1,39 @@
+#include "GlyphRaster.h"
+
+namespace {
+    // Distance field spread in pixels around the outline, and the matching stbtt parameters
+    const int SdfPadding = 4;
+    const unsigned char SdfOnEdgeValue = 128;
+    const float SdfPixelDistScale = (float)SdfOnEdgeValue / SdfPadding;
+}
+
+void rasterizeGlyph(const stbtt_fontinfo& font, float scale, GlyphRaster raster, int glyphIndex, RasterizedGlyph& out) {
+    int advance, leftSideBearing;
+    stbtt_GetGlyphHMetrics(&font, glyphIndex, &advance, &leftSideBearing);
+    out.xadvance = advance * scale;
+    out.pixels.clear();
+
+    if (raster == GlyphRaster::SignedDistance) {
+        // Returns NULL for glyphs without an outline, such as space
+        unsigned char* sdf = stbtt_GetGlyphSDF(&font, scale, glyphIndex, SdfPadding, SdfOnEdgeValue, SdfPixelDistScale,
+                                               &out.width, &out.height, &out.xoff, &out.yoff);
+        if (!sdf) {
+            out.width = out.height = out.xoff = out.yoff = 0;
+            return;
+        }
+        out.pixels.assign(sdf, sdf + (size_t)out.width * out.height);
+        stbtt_FreeSDF(sdf, NULL);
+        return;
+    }
+
+    int ix1, iy1;
+    stbtt_GetGlyphBitmapBox(&font, glyphIndex, scale, scale, &out.xoff, &out.yoff, &ix1, &iy1);
+    out.width = ix1 - out.xoff;
+    out.height = iy1 - out.yoff;
+    if (out.width <= 0 || out.height <= 0) {
+        out.width = out.height = 0;
+        return;
+    }
+    out.pixels.assign((size_t)out.width * out.height, 0);
+    stbtt_MakeGlyphBitmap(&font, out.pixels.data(), out.width, out.height, out.width, scale, scale, glyphIndex);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "stb_truetype.h"
+
+// --- Glyph rasterization ---
+// Shared by the runtime glyph cache and the offline font cooker so both produce identical glyphs.
+
+enum class GlyphRaster {
+    Coverage,       // Anti-aliased coverage, sharp only at the size it was rasterized at
+    SignedDistance  // Signed distance field, 0.5 on the outline, scales to any size
+};
+
+struct RasterizedGlyph {
+    int width = 0, height = 0;
+    int xoff = 0, yoff = 0;           // Offset from the pen position to the top-left of the bitmap
+    float xadvance = 0.0f;
+    std::vector<unsigned char> pixels; // width * height, one byte per pixel, empty for blank glyphs
+};
+
+// Rasterize glyphIndex of font at the given stbtt scale
+void rasterizeGlyph(const stbtt_fontinfo& font, float scale, GlyphRaster raster, int glyphIndex, RasterizedGlyph& out);
@@ -0,0 +1,426 @@
+#include "GpuCuller.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "GlState.h"
+
+// Tokens and entry points of OpenGL 4.0 to 4.3 (ARB_transform_feedback2, ARB_transform_feedback_instanced,
+// ARB_draw_indirect, ARB_shader_image_load_store, ARB_compute_shader, ARB_shader_storage_buffer_object)
+#define GL_TRANSFORM_FEEDBACK 0x8E22
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+
+namespace {
+    typedef void (APIENTRYP GenTransformFeedbacksProc)(GLsizei n, GLuint* ids);
+    typedef void (APIENTRYP DeleteTransformFeedbacksProc)(GLsizei n, const GLuint* ids);
+    typedef void (APIENTRYP BindTransformFeedbackProc)(GLenum target, GLuint id);
+    typedef void (APIENTRYP DrawTransformFeedbackInstancedProc)(GLenum mode, GLuint id, GLsizei instanceCount);
+    typedef void (APIENTRYP DispatchComputeProc)(GLuint x, GLuint y, GLuint z);
+    typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+    typedef void (APIENTRYP DrawArraysIndirectProc)(GLenum mode, const void* indirect);
+    typedef void (APIENTRYP DrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect);
+
+    GenTransformFeedbacksProc genTransformFeedbacks = nullptr;
+    DeleteTransformFeedbacksProc deleteTransformFeedbacks = nullptr;
+    BindTransformFeedbackProc bindTransformFeedback = nullptr;
+    DrawTransformFeedbackInstancedProc drawTransformFeedbackInstanced = nullptr;
+    DispatchComputeProc dispatchCompute = nullptr;
+    MemoryBarrierProc memoryBarrier = nullptr;
+    DrawArraysIndirectProc drawArraysIndirect = nullptr;
+    DrawElementsIndirectProc drawElementsIndirect = nullptr;
+
+    const int CommandSlots = 16;        // Indirect draws per frame
+    const GLsizeiptr CommandSlotSize = 32;
+    const GLuint ComputeGroupSize = 256;
+
+    // Per instance: the bounding box test. Attribute locations match CubeInstance (see CubeField.h),
+    // with the color read as its raw 32 bits so it is captured unchanged.
+    const char* cullVertexShaderSource = R"(
+        #version 330 core
+        layout (location = 3) in mat4 aModel;
+        layout (location = 7) in uint aColor;
+        layout (location = 8) in float aLayer;
+        out mat4 vModel;
+        flat out uint vColor;
+        out float vLayer;
+        flat out int vVisible;
+
+        uniform vec4 planes[6]; // Frustum planes in the space of the instances' model matrices
+
+        void main() {
+            // The box around the unit cube, as in cubeBounds()
+            vec3 center = aModel[3].xyz;
+            vec3 halfSize = 0.5 * (abs(aModel[0].xyz) + abs(aModel[1].xyz) + abs(aModel[2].xyz));
+            bool inside = true;
+            for (int i = 0; i < 6; ++i)
+                inside = inside && dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), halfSize) >= 0.0;
+            vModel = aModel;
+            vColor = aColor;
+            vLayer = aLayer;
+            vVisible = inside ? 1 : 0;
+        }
+    )";
+
+    // Pass visible instances on to transform feedback, COPIES times each
+    const char* cullGeometryShaderSource = R"(
+        #version 330 core
+        layout (points) in;
+        layout (points, max_vertices = COPIES) out;
+        in mat4 vModel[];
+        flat in uint vColor[];
+        in float vLayer[];
+        flat in int vVisible[];
+        out mat4 outModel;
+        flat out uint outColor;
+        out float outLayer;
+
+        void main() {
+            if (vVisible[0] == 0)
+                return;
+            for (int i = 0; i < COPIES; ++i) {
+                outModel = vModel[0];
+                outColor = vColor[0];
+                outLayer = vLayer[0];
+                EmitVertex();
+            }
+            EndPrimitive();
+        }
+    )";
+
+    // Appends visible instances to the visible buffer. Records are moved as 18 raw words, as in CubeInstance.
+    const char* cullComputeShaderSource = R"(
+        #version 430 core
+        layout (local_size_x = 256) in;
+        layout (std430, binding = 0) readonly buffer Source { uint source[]; };
+        layout (std430, binding = 1) writeonly buffer Visible { uint visible[]; };
+        layout (std430, binding = 2) buffer Counter { uint visibleCount; };
+
+        uniform vec4 planes[6];
+        uniform int instanceCount;
+
+        const uint Words = 18u;
+
+        vec3 column(uint base, uint i) {
+            return uintBitsToFloat(uvec3(source[base + i * 4u], source[base + i * 4u + 1u], source[base + i * 4u + 2u]));
+        }
+
+        void main() {
+            uint index = gl_GlobalInvocationID.x;
+            if (index >= uint(instanceCount))
+                return;
+            uint base = index * Words;
+            vec3 center = column(base, 3u);
+            vec3 halfSize = 0.5 * (abs(column(base, 0u)) + abs(column(base, 1u)) + abs(column(base, 2u)));
+            for (int i = 0; i < 6; ++i) {
+                if (dot(planes[i].xyz, center) + planes[i].w + dot(abs(planes[i].xyz), halfSize) < 0.0)
+                    return;
+            }
+            uint slot = atomicAdd(visibleCount, 1u) * Words;
+            for (uint i = 0u; i < Words; ++i)
+                visible[slot + i] = source[base + i];
+        }
+    )";
+
+    bool hasVersion(int major, int minor) {
+        return GLVersion.major > major || (GLVersion.major == major && GLVersion.minor >= minor);
+    }
+
+    bool hasExtension(const char* name) {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; ++i) {
+            const GLubyte* extension = glGetStringi(GL_EXTENSIONS, i);
+            if (extension && std::strcmp(reinterpret_cast<const char*>(extension), name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    void loadEntryPoints(GLADloadproc loadProc) {
+        genTransformFeedbacks = (GenTransformFeedbacksProc)loadProc("glGenTransformFeedbacks");
+        deleteTransformFeedbacks = (DeleteTransformFeedbacksProc)loadProc("glDeleteTransformFeedbacks");
+        bindTransformFeedback = (BindTransformFeedbackProc)loadProc("glBindTransformFeedback");
+        drawTransformFeedbackInstanced = (DrawTransformFeedbackInstancedProc)loadProc("glDrawTransformFeedbackInstanced");
+        dispatchCompute = (DispatchComputeProc)loadProc("glDispatchCompute");
+        memoryBarrier = (MemoryBarrierProc)loadProc("glMemoryBarrier");
+        drawArraysIndirect = (DrawArraysIndirectProc)loadProc("glDrawArraysIndirect");
+        drawElementsIndirect = (DrawElementsIndirectProc)loadProc("glDrawElementsIndirect");
+    }
+
+    bool supports(GpuCullMethod method) {
+        switch (method) {
+        case GpuCullMethod::Compute:
+            return hasVersion(4, 3) && dispatchCompute && memoryBarrier && drawArraysIndirect && drawElementsIndirect;
+        case GpuCullMethod::Feedback:
+            return (hasVersion(4, 2) || (hasExtension("GL_ARB_transform_feedback2") && hasExtension("GL_ARB_transform_feedback_instanced")))
+                && genTransformFeedbacks && deleteTransformFeedbacks && bindTransformFeedback && drawTransformFeedbackInstanced;
+        default:
+            return true;
+        }
+    }
+
+    GLuint compileStage(GLenum type, const std::string& source) {
+        GLuint shader = glCreateShader(type);
+        const char* code = source.c_str();
+        glShaderSource(shader, 1, &code, NULL);
+        glCompileShader(shader);
+        int success;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            char infoLog[512];
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::CULLING::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+
+    // Link the stages, capturing varyings with transform feedback if any are given. Deletes the stages.
+    GLuint linkProgram(const GLuint* stages, int stageCount, const char* const* varyings, int varyingCount) {
+        GLuint program = glCreateProgram();
+        for (int i = 0; i < stageCount; ++i)
+            glAttachShader(program, stages[i]);
+        if (varyingCount > 0)
+            glTransformFeedbackVaryings(program, varyingCount, varyings, GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(program);
+        int success;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        for (int i = 0; i < stageCount; ++i)
+            glDeleteShader(stages[i]);
+        if (!success) {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cerr << "ERROR::SHADER::CULLING::LINKING_FAILED\n" << infoLog << std::endl;
+            glState.deleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+
+    size_t indexSize(GLenum indexType) {
+        return indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+    }
+
+    GLint uniformLocation(const ShaderProgram& program, const char* name) {
+        for (const UniformSlot& slot : program.uniforms()) {
+            if (slot.name == name)
+                return slot.location;
+        }
+        return -1;
+    }
+}
+
+const char* gpuCullMethodName(GpuCullMethod method) {
+    switch (method) {
+    case GpuCullMethod::Feedback: return "transform feedback draw";
+    case GpuCullMethod::Compute: return "compute";
+    default: return "transform feedback query";
+    }
+}
+
+GpuCullMethod GpuCuller::bestMethod(GLADloadproc loadProc) {
+    loadEntryPoints(loadProc);
+    if (supports(GpuCullMethod::Compute)) return GpuCullMethod::Compute;
+    if (supports(GpuCullMethod::Feedback)) return GpuCullMethod::Feedback;
+    return GpuCullMethod::Query;
+}
+
+bool GpuCuller::init(const std::vector<CubeInstance>& instances, GpuCullMethod method, GLADloadproc loadProc) {
+    destroy();
+    loadEntryPoints(loadProc);
+    selected = supports(method) ? method : bestMethod(loadProc);
+    if (selected != method)
+        std::cout << "GPU culling: " << gpuCullMethodName(method) << " isn't supported, using " << gpuCullMethodName(selected) << std::endl;
+    instanceCount = instances.size();
+
+    // The Feedback method captures three records per visible instance
+    int copies = selected == GpuCullMethod::Feedback ? 3 : 1;
+    glGenBuffers(1, &source);
+    glGenBuffers(1, &visible);
+    GLenum target = selected == GpuCullMethod::Compute ? GL_SHADER_STORAGE_BUFFER : GL_ARRAY_BUFFER;
+    glState.bindBuffer(target, source);
+    glBufferData(target, instanceCount * sizeof(CubeInstance), instances.data(), GL_STATIC_DRAW);
+    glState.bindBuffer(target, visible);
+    glBufferData(target, instanceCount * copies * sizeof(CubeInstance), NULL, GL_DYNAMIC_COPY);
+    glState.bindBuffer(target, 0);
+    if (glGetError() == GL_OUT_OF_MEMORY) {
+        std::cerr << "GPU culling: not enough memory for " << instanceCount << " instances" << std::endl;
+        destroy();
+        return false;
+    }
+
+    bool ready = selected == GpuCullMethod::Compute ? createComputeProgram() : createFeedbackProgram(copies);
+    if (!ready) {
+        destroy();
+        return false;
+    }
+    std::cout << "GPU culling: " << gpuCullMethodName(selected) << std::endl;
+    return true;
+}
+
+bool GpuCuller::createFeedbackProgram(int copies) {
+    std::string defines = "#define COPIES " + std::to_string(copies) + "\n";
+    std::string geometrySource = cullGeometryShaderSource;
+    geometrySource.insert(geometrySource.find('\n', geometrySource.find("#version")) + 1, defines);
+    GLuint stages[2] = { compileStage(GL_VERTEX_SHADER, cullVertexShaderSource), compileStage(GL_GEOMETRY_SHADER, geometrySource) };
+    const char* varyings[3] = { "outModel", "outColor", "outLayer" }; // Interleaved, they make up a CubeInstance
+    GLuint linked = linkProgram(stages, 2, varyings, 3);
+    if (!linked)
+        return false;
+    program.create(linked);
+    planesLocation = uniformLocation(program, "planes");
+
+    // One point per instance
+    glGenVertexArrays(1, &sourceVAO);
+    glState.bindVertexArray(sourceVAO);
+    glState.bindBuffer(GL_ARRAY_BUFFER, source);
+    for (GLuint column = 0; column < 4; ++column) {
+        glEnableVertexAttribArray(CubeInstanceModelLocation + column);
+        glVertexAttribPointer(CubeInstanceModelLocation + column, 4, GL_FLOAT, GL_FALSE, sizeof(CubeInstance),
+                              (void*)(offsetof(CubeInstance, model) + column * sizeof(float) * 4));
+    }
+    glEnableVertexAttribArray(CubeInstanceColorLocation);
+    glVertexAttribIPointer(CubeInstanceColorLocation, 1, GL_UNSIGNED_INT, sizeof(CubeInstance), (void*)offsetof(CubeInstance, color));
+    glEnableVertexAttribArray(CubeInstanceLayerLocation);
+    glVertexAttribPointer(CubeInstanceLayerLocation, 1, GL_FLOAT, GL_FALSE, sizeof(CubeInstance), (void*)offsetof(CubeInstance, layer));
+    glState.bindVertexArray(0);
+    glState.bindBuffer(GL_ARRAY_BUFFER, 0);
+
+    if (selected == GpuCullMethod::Feedback) {
+        genTransformFeedbacks(1, &feedback);
+        bindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback);
+        glState.bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, visible);
+        bindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    } else {
+        glGenQueries(1, &query);
+    }
+    return true;
+}
+
+bool GpuCuller::createComputeProgram() {
+    GLuint stage = compileStage(GL_COMPUTE_SHADER, cullComputeShaderSource);
+    GLuint linked = linkProgram(&stage, 1, nullptr, 0);
+    if (!linked)
+        return false;
+    program.create(linked);
+    planesLocation = uniformLocation(program, "planes");
+    countLocation = uniformLocation(program, "instanceCount");
+
+    glGenBuffers(1, &counter);
+    glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, counter);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+    glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glGenBuffers(1, &commands);
+    glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER, CommandSlots * CommandSlotSize, NULL, GL_DYNAMIC_DRAW);
+    glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    return true;
+}
+
+void GpuCuller::destroy() {
+    program.destroy();
+    glState.deleteBuffers(1, &source);
+    glState.deleteBuffers(1, &visible);
+    glState.deleteBuffers(1, &counter);
+    glState.deleteBuffers(1, &commands);
+    glState.deleteVertexArrays(1, &sourceVAO);
+    if (feedback && deleteTransformFeedbacks)
+        deleteTransformFeedbacks(1, &feedback);
+    glDeleteQueries(1, &query);
+    source = visible = counter = commands = sourceVAO = feedback = query = 0;
+    instanceCount = 0;
+    lastVisibleCount = -1;
+}
+
+void GpuCuller::cull(const Frustum& frustum) {
+    program.use();
+    glUniform4fv(planesLocation, 6, &frustum.planes[0].x);
+    commandSlot = 0;
+
+    if (selected == GpuCullMethod::Compute) {
+        const GLuint zero = 0;
+        glState.bindBuffer(GL_SHADER_STORAGE_BUFFER, counter);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(zero), &zero);
+        glUniform1i(countLocation, (GLint)instanceCount);
+        glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, source);
+        glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visible);
+        glState.bindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, counter);
+        dispatchCompute((GLuint)((instanceCount + ComputeGroupSize - 1) / ComputeGroupSize), 1, 1);
+        // The counter is copied into draw commands, and the records are read as vertex attributes
+        memoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+        return;
+    }
+
+    glState.enable(GL_RASTERIZER_DISCARD);
+    glState.bindVertexArray(sourceVAO);
+    if (selected == GpuCullMethod::Feedback) {
+        bindTransformFeedback(GL_TRANSFORM_FEEDBACK, feedback);
+    } else {
+        glState.bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, visible);
+        glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, query);
+    }
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, (GLsizei)instanceCount);
+    glEndTransformFeedback();
+    if (selected == GpuCullMethod::Feedback) {
+        bindTransformFeedback(GL_TRANSFORM_FEEDBACK, 0);
+    } else {
+        glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        glState.bindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        countPending = true; // Read as late as possible, by the first draw
+    }
+    glState.disable(GL_RASTERIZER_DISCARD);
+}
+
+void GpuCuller::readVisibleCount() {
+    if (!countPending)
+        return;
+    GLuint written = 0;
+    glGetQueryObjectuiv(query, GL_QUERY_RESULT, &written); // Waits for the culling pass
+    lastVisibleCount = written;
+    countPending = false;
+}
+
+void GpuCuller::draw(GLint first, GLsizei count, GLenum indexType) {
+    switch (selected) {
+    case GpuCullMethod::Query: {
+        readVisibleCount();
+        GLsizei instances = (GLsizei)lastVisibleCount;
+        if (instances <= 0)
+            return;
+        if (indexType)
+            glDrawElementsInstanced(GL_TRIANGLES, count, indexType, (void*)(first * indexSize(indexType)), instances);
+        else
+            glDrawArraysInstanced(GL_TRIANGLES, first, count, instances);
+        break;
+    }
+    case GpuCullMethod::Feedback:
+        // Every captured vertex is one corner of a triangle, every draw instance one triangle of the cube
+        drawTransformFeedbackInstanced(GL_TRIANGLES, feedback, count / 3);
+        break;
+    case GpuCullMethod::Compute: {
+        if (commandSlot >= CommandSlots) {
+            std::cerr << "GPU culling: more than " << CommandSlots << " draws in a frame" << std::endl;
+            return;
+        }
+        // DrawElementsIndirectCommand or DrawArraysIndirectCommand, with the instance count filled in from the counter
+        GLuint command[5] = { (GLuint)count, 0, (GLuint)first, 0, 0 };
+        GLintptr offset = commandSlot++ * CommandSlotSize;
+        glState.bindBuffer(GL_DRAW_INDIRECT_BUFFER, commands);
+        glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offset, indexType ? 5 * sizeof(GLuint) : 4 * sizeof(GLuint), command);
+        glState.bindBuffer(GL_COPY_READ_BUFFER, counter);
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_DRAW_INDIRECT_BUFFER, 0, offset + sizeof(GLuint), sizeof(GLuint));
+        if (indexType)
+            drawElementsIndirect(GL_TRIANGLES, indexType, (void*)offset);
+        else
+            drawArraysIndirect(GL_TRIANGLES, (void*)offset);
+        break;
+    }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "CubeField.h"
+#include "FrustumCuller.h"
+#include "ShaderProgram.h"
+
+// --- GPU frustum culling ---
+// Culls the cube field on the GPU so visibility never has to be computed, or read, on the CPU.
+// The instances are run through a vertex shader as points with rasterizer discard: the vertex
+// shader tests the instance's bounding box against the frustum planes, and a geometry shader passes
+// only the visible ones on to transform feedback, which packs them into a buffer of CubeInstance
+// records the cube draw reads. How the draw learns how many there are depends on the context:
+//  - Query (3.3 core): a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN query, read back before the draw.
+//  - Feedback (4.2, or ARB_transform_feedback2 and _instanced): glDrawTransformFeedbackInstanced.
+//    It takes its vertex count from the feedback, so the culling pass writes every visible
+//    instance three times, and the draw turns each triple into one triangle of that cube with
+//    one draw instance per triangle of the cube (see the FEEDBACK shader feature).
+//  - Compute (4.3): a compute shader appends the visible instances with an atomic counter, which
+//    is copied into the instance count of indirect draw commands.
+// The GL 4.x entry points are outside our 3.3 glad loader and are resolved in init().
+
+enum class GpuCullMethod {
+    Query,
+    Feedback,
+    Compute
+};
+const char* gpuCullMethodName(GpuCullMethod method);
+
+class GpuCuller {
+public:
+    // Copy the instances to the GPU and build the programs and buffers of method. If the context lacks
+    // method, the best one it has is used instead. loadProc resolves GL entry points, like the one
+    // passed to gladLoadGLLoader.
+    bool init(const std::vector<CubeInstance>& instances, GpuCullMethod method, GLADloadproc loadProc);
+    void destroy();
+
+    GpuCullMethod method() const { return selected; }
+    // The best method the current context supports
+    static GpuCullMethod bestMethod(GLADloadproc loadProc);
+
+    // The visible CubeInstance records of the last cull()
+    GLuint visibleBuffer() const { return visible; }
+    // With the Feedback method, draws read three records per visible instance, one per vertex.
+    // Otherwise they read one record per draw instance.
+    GLuint instanceDivisor() const { return selected == GpuCullMethod::Feedback ? 0 : 1; }
+
+    // Find the instances inside frustum. Call before draw(), once per frame.
+    void cull(const Frustum& frustum);
+
+    // Draw cube vertices [first, first + count) of every visible instance, with the bound program and VAO.
+    // indexType is the type of the cube's indices, or 0 for the procedural cube. With the Feedback
+    // method the cube is always procedural, and the program's firstTriangle must be first / 3.
+    void draw(GLint first, GLsizei count, GLenum indexType);
+
+    // Visible instances after the last cull(), where the method brings the count back to the CPU, else -1
+    long long visibleCount() const { return lastVisibleCount; }
+
+private:
+    bool createFeedbackProgram(int copies);
+    bool createComputeProgram();
+    void readVisibleCount();
+
+    GpuCullMethod selected = GpuCullMethod::Query;
+    size_t instanceCount = 0;
+    GLuint source = 0;          // Every instance
+    GLuint visible = 0;         // The visible ones
+    GLuint sourceVAO = 0;       // Reads source one instance per point, for the transform feedback pass
+    GLuint feedback = 0;        // Transform feedback object (Feedback)
+    GLuint query = 0;           // Primitives written (Query)
+    GLuint counter = 0;         // Atomic count of visible instances (Compute)
+    GLuint commands = 0;        // Indirect draw commands, one slot per draw of the frame (Compute)
+    int commandSlot = 0;
+    ShaderProgram program;
+    GLint planesLocation = -1;
+    GLint countLocation = -1;
+    bool countPending = false;
+    long long lastVisibleCount = -1;
+};
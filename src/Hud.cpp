@@ -0,0 +1,118 @@
+#include "Hud.h"
+
+#include <cmath>
+#include <iostream>
+
+#include "GlState.h"
+
+void Hud::init(GLuint program) {
+    compositeProgram = program;
+    glState.useProgram(compositeProgram);
+    glUniform1i(glGetUniformLocation(compositeProgram, "hud"), 0);
+    glState.useProgram(0);
+    glGenVertexArrays(1, &compositeVAO);
+    glGenFramebuffers(1, &framebuffer);
+    glGenTextures(1, &colorTexture);
+}
+
+void Hud::destroy() {
+    glState.deleteFramebuffers(1, &framebuffer);
+    glState.deleteTextures(1, &colorTexture);
+    glState.deleteVertexArrays(1, &compositeVAO);
+    glState.deleteProgram(compositeProgram);
+    framebuffer = colorTexture = compositeVAO = compositeProgram = 0;
+}
+
+bool Hud::resize(int newWidth, int newHeight) {
+    if (newWidth == width && newHeight == height)
+        return true;
+    width = newWidth;
+    height = newHeight;
+    if (width == 0 || height == 0)
+        return true; // Minimized, nothing to draw into
+
+    glState.bindTexture(GL_TEXTURE_2D, colorTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glState.bindTexture(GL_TEXTURE_2D, 0);
+
+    glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    if (complete) {
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    } else {
+        std::cerr << "HUD framebuffer is incomplete at " << width << "x" << height << std::endl;
+    }
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // The texture starts out empty, so nothing is left to clear
+    for (HudWidget& widget : widgets)
+        widget.bounds = HudRect();
+    invalidate();
+    return complete;
+}
+
+size_t Hud::addText(const std::string& text, float x, float y, float scale, glm::vec3 color) {
+    HudWidget widget;
+    widget.text = text;
+    widget.x = x;
+    widget.y = y;
+    widget.scale = scale;
+    widget.color = color;
+    widgets.push_back(widget);
+    anyDirty = true;
+    return widgets.size() - 1;
+}
+
+void Hud::setText(size_t widget, const std::string& text) {
+    HudWidget& target = widgets[widget];
+    if (target.text == text)
+        return;
+    target.text = text;
+    target.dirty = true;
+    anyDirty = true;
+}
+
+void Hud::invalidate() {
+    for (HudWidget& widget : widgets)
+        widget.dirty = true;
+    anyDirty = true;
+}
+
+void Hud::beginRedraw(const HudRect& damage) {
+    // Whole pixels, with the scissor's origin at the bottom left
+    int x0 = std::max(0, (int)std::floor(damage.x0));
+    int y0 = std::max(0, (int)std::floor(damage.y0));
+    int x1 = std::min(width, (int)std::ceil(damage.x1));
+    int y1 = std::min(height, (int)std::ceil(damage.y1));
+
+    glState.bindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    glState.enable(GL_SCISSOR_TEST);
+    glScissor(x0, height - y1, std::max(0, x1 - x0), std::max(0, y1 - y0));
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    // Keep the texture premultiplied so compositing it matches drawing the text straight to the screen
+    glState.blendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+void Hud::endRedraw() {
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glState.disable(GL_SCISSOR_TEST);
+    glState.bindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void Hud::composite() {
+    if (width == 0 || height == 0)
+        return;
+    glState.useProgram(compositeProgram);
+    glState.activeTexture(GL_TEXTURE0);
+    glState.bindTexture(GL_TEXTURE_2D, colorTexture);
+    glState.bindVertexArray(compositeVAO);
+    glState.blendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glState.blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// --- Retained HUD ---
+// Owns the overlay widgets and keeps what they look like in an offscreen texture the size of the
+// window. Widgets are marked dirty when they change, and only the area they cover (before and after
+// the change) is cleared and drawn again. Every frame the texture is composited over the scene with
+// one full-screen triangle, so a HUD that doesn't change costs a single draw.
+// The HUD doesn't draw text itself: redraw() hands widgets to the app's text renderer.
+
+// Screen area in pixels, y down, x1/y1 exclusive
+struct HudRect {
+    float x0 = 0.0f, y0 = 0.0f, x1 = 0.0f, y1 = 0.0f;
+
+    bool empty() const { return x1 <= x0 || y1 <= y0; }
+    bool intersects(const HudRect& other) const {
+        return !empty() && !other.empty() && x0 < other.x1 && other.x0 < x1 && y0 < other.y1 && other.y0 < y1;
+    }
+    void add(const HudRect& other) {
+        if (other.empty())
+            return;
+        if (empty()) {
+            *this = other;
+            return;
+        }
+        x0 = std::min(x0, other.x0);
+        y0 = std::min(y0, other.y0);
+        x1 = std::max(x1, other.x1);
+        y1 = std::max(y1, other.y1);
+    }
+};
+
+// A line of text. Other kinds of widgets (icons) would add their own fields here.
+struct HudWidget {
+    std::string text;
+    float x = 0.0f, y = 0.0f; // Pen position of the first glyph, on the baseline
+    float scale = 1.0f;
+    glm::vec3 color = glm::vec3(1.0f);
+    HudRect bounds;           // Area covered in the HUD texture when last drawn
+    bool dirty = true;
+};
+
+class Hud {
+public:
+    // Takes ownership of the program that composites the HUD texture
+    void init(GLuint compositeProgram);
+    void destroy();
+
+    // Match the window's framebuffer size. A new size clears the texture and redraws every widget.
+    bool resize(int width, int height);
+
+    // Returns the widget's index, valid for the lifetime of the HUD
+    size_t addText(const std::string& text, float x, float y, float scale, glm::vec3 color = glm::vec3(1.0f));
+    // Marks the widget dirty only if the text actually changed
+    void setText(size_t widget, const std::string& text);
+    // Redraw every widget, e.g. after switching how text is rendered
+    void invalidate();
+
+    bool isDirty() const { return anyDirty; }
+
+    // Bring the HUD texture up to date. queue(const HudWidget&) queues the widget with the app's text
+    // renderer and returns the area it covers; flush() draws everything queued. The caller has set up
+    // the text projection for the framebuffer size. Returns how many widgets were drawn.
+    template <typename QueueFunction, typename FlushFunction>
+    int redraw(QueueFunction&& queue, FlushFunction&& flush);
+
+    // Blend the HUD texture over the current framebuffer
+    void composite();
+
+private:
+    void beginRedraw(const HudRect& damage);
+    void endRedraw();
+
+    std::vector<HudWidget> widgets;
+    bool anyDirty = true;
+    int width = 0, height = 0;
+
+    GLuint framebuffer = 0;
+    GLuint colorTexture = 0;
+    GLuint compositeProgram = 0;
+    GLuint compositeVAO = 0; // Empty, the full-screen triangle comes from gl_VertexID
+};
+
+template <typename QueueFunction, typename FlushFunction>
+int Hud::redraw(QueueFunction&& queue, FlushFunction&& flush) {
+    if (!anyDirty || width == 0 || height == 0)
+        return 0;
+    anyDirty = false;
+
+    // Where changed widgets were and now are has to be cleared and drawn again
+    HudRect damage;
+    int drawn = 0;
+    std::vector<bool> queued(widgets.size(), false);
+    for (size_t i = 0; i < widgets.size(); ++i) {
+        HudWidget& widget = widgets[i];
+        if (!widget.dirty)
+            continue;
+        damage.add(widget.bounds);
+        widget.bounds = queue(static_cast<const HudWidget&>(widget));
+        damage.add(widget.bounds);
+        widget.dirty = false;
+        queued[i] = true;
+        drawn++;
+    }
+    if (damage.empty())
+        return drawn;
+
+    // Unchanged widgets under the damage are cleared with it. Drawing them again is clipped to the
+    // damage, so the parts outside it aren't blended twice.
+    for (size_t i = 0; i < widgets.size(); ++i) {
+        if (!queued[i] && widgets[i].bounds.intersects(damage)) {
+            queue(static_cast<const HudWidget&>(widgets[i]));
+            drawn++;
+        }
+    }
+
+    beginRedraw(damage);
+    flush();
+    endRedraw();
+    return drawn;
+}
@@ -0,0 +1,172 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+struct Job {
+    std::function<void()> work;
+    std::atomic<int> pending{ 1 };     // Unfinished dependencies, plus one until submit() has registered them all
+    std::atomic<bool> finished{ false };
+    std::mutex mutex;                  // Guards dependents against finishing while a job is added to them
+    std::vector<JobHandle> dependents; // Jobs waiting for this one
+};
+
+namespace {
+    // Which pool's worker the current thread is, if any
+    thread_local const JobSystem* currentSystem = nullptr;
+    thread_local unsigned currentWorker = 0;
+}
+
+void JobSystem::init(int workerThreads) {
+    shutdown();
+    if (workerThreads < 0)
+        workerThreads = (int)std::max(1u, std::thread::hardware_concurrency()) - 1;
+    for (int i = 0; i <= workerThreads; ++i)
+        queues.push_back(std::make_unique<WorkerQueue>());
+    stopping = false;
+    currentSystem = this;
+    currentWorker = 0;
+    for (int i = 1; i <= workerThreads; ++i)
+        threads.emplace_back([this, i] { workerLoop((unsigned)i); });
+}
+
+void JobSystem::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wakeCondition.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+    threads.clear();
+    queues.clear(); // Jobs never run are dropped
+    queued = 0;
+    if (currentSystem == this)
+        currentSystem = nullptr;
+}
+
+unsigned JobSystem::currentIndex() const {
+    // Threads outside the pool share worker 0's deque
+    return currentSystem == this ? currentWorker : 0;
+}
+
+JobHandle JobSystem::submit(std::function<void()> work, std::initializer_list<JobHandle> dependencies) {
+    return submit(std::move(work), std::vector<JobHandle>(dependencies));
+}
+
+JobHandle JobSystem::submit(std::function<void()> work, const std::vector<JobHandle>& dependencies) {
+    JobHandle job = std::make_shared<Job>();
+    job->work = std::move(work);
+    for (const JobHandle& dependency : dependencies) {
+        if (!dependency)
+            continue;
+        std::lock_guard<std::mutex> lock(dependency->mutex);
+        if (!dependency->finished) {
+            job->pending++;
+            dependency->dependents.push_back(job);
+        }
+    }
+    if (--job->pending == 0)
+        enqueue(job);
+    return job;
+}
+
+JobHandle JobSystem::parallelFor(size_t count, size_t minBatch, std::function<void(size_t, size_t)> body,
+                                 std::initializer_list<JobHandle> dependencies) {
+    size_t batches = std::clamp<size_t>(count / std::max<size_t>(minBatch, 1), 1, threadCount() * BatchesPerThread);
+    auto shared = std::make_shared<std::function<void(size_t, size_t)>>(std::move(body));
+    std::vector<JobHandle> batchJobs;
+    batchJobs.reserve(batches);
+    for (size_t b = 0; b < batches; ++b) {
+        size_t begin = count * b / batches, end = count * (b + 1) / batches;
+        batchJobs.push_back(submit([shared, begin, end] { (*shared)(begin, end); }, dependencies));
+    }
+    if (batches == 1)
+        return batchJobs[0];
+    return submit([] {}, batchJobs);
+}
+
+void JobSystem::enqueue(JobHandle job) {
+    WorkerQueue& queue = *queues[currentIndex()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    {
+        // Counted under the wake mutex, so a thread checking for work before it sleeps can't miss it
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        queued++;
+    }
+    wakeCondition.notify_one();
+}
+
+JobHandle JobSystem::findJob(unsigned index) {
+    // Newest first from our own deque, oldest first from the others
+    for (size_t i = 0; i < queues.size(); ++i) {
+        WorkerQueue& queue = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty())
+            continue;
+        JobHandle job;
+        if (i == 0) {
+            job = std::move(queue.jobs.back());
+            queue.jobs.pop_back();
+        } else {
+            job = std::move(queue.jobs.front());
+            queue.jobs.pop_front();
+        }
+        queued--;
+        return job;
+    }
+    return nullptr;
+}
+
+void JobSystem::run(const JobHandle& job) {
+    job->work();
+    job->work = nullptr; // Free what it captured now rather than when the last handle goes
+    std::vector<JobHandle> dependents;
+    {
+        std::lock_guard<std::mutex> lock(job->mutex);
+        job->finished = true;
+        dependents.swap(job->dependents);
+    }
+    for (JobHandle& dependent : dependents) {
+        if (--dependent->pending == 0)
+            enqueue(std::move(dependent));
+    }
+    if (sleepingWaiters > 0) {
+        { std::lock_guard<std::mutex> lock(wakeMutex); }
+        wakeCondition.notify_all();
+    }
+}
+
+void JobSystem::workerLoop(unsigned index) {
+    currentSystem = this;
+    currentWorker = index;
+    for (;;) {
+        if (JobHandle job = findJob(index)) {
+            run(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        wakeCondition.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping)
+            return;
+    }
+}
+
+void JobSystem::wait(const JobHandle& job) {
+    if (!job)
+        return;
+    unsigned index = currentIndex();
+    while (!job->finished) {
+        if (JobHandle next = findJob(index)) {
+            run(next);
+            continue;
+        }
+        // Nothing to help with: the job is running on another thread, or waiting for one that is
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleepingWaiters++;
+        wakeCondition.wait(lock, [&] { return job->finished || queued > 0; });
+        sleepingWaiters--;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// --- Job system ---
+// A pool of worker threads that run jobs: small functions that may wait for other jobs to finish
+// before they start. Every worker has its own deque of jobs. A worker pushes the jobs it submits to
+// the back of its deque and pops from the back, so it picks up the work whose data is still in
+// its cache. When its deque is empty it steals the oldest job from the front of another one, which
+// tends to be the largest piece of work left. The thread that calls init() is worker 0. It runs
+// jobs while it waits for one, so a pool without extra threads still works, one job at a time.
+// Jobs must not touch the GL context, which stays with the main thread.
+
+struct Job;
+typedef std::shared_ptr<Job> JobHandle;
+
+class JobSystem {
+public:
+    // Batches parallelFor() aims for per thread, so a thread that finishes early can steal the rest
+    static const size_t BatchesPerThread = 4;
+
+    ~JobSystem() { shutdown(); }
+
+    // Start workerThreads threads besides the calling one, -1 for one per extra hardware thread
+    void init(int workerThreads = -1);
+    void shutdown();
+    // Threads that run jobs, counting the one that called init()
+    unsigned threadCount() const { return (unsigned)queues.size(); }
+
+    // Queue work to run once every job in dependencies has finished. Null dependencies are ignored.
+    JobHandle submit(std::function<void()> work, std::initializer_list<JobHandle> dependencies = {});
+    JobHandle submit(std::function<void()> work, const std::vector<JobHandle>& dependencies);
+    // Run body(begin, end) over [0, count) in batches of at least minBatch indices. The returned job
+    // finishes when every batch has.
+    JobHandle parallelFor(size_t count, size_t minBatch, std::function<void(size_t, size_t)> body,
+                          std::initializer_list<JobHandle> dependencies = {});
+    // Run queued jobs until job has finished
+    void wait(const JobHandle& job);
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<JobHandle> jobs;
+    };
+
+    void workerLoop(unsigned index);
+    unsigned currentIndex() const;
+    void enqueue(JobHandle job);
+    JobHandle findJob(unsigned index);
+    void run(const JobHandle& job);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues; // queues[0] belongs to the thread that called init()
+    std::vector<std::thread> threads;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCondition;  // Idle workers, and threads in wait(), sleep on this
+    std::atomic<size_t> queued{ 0 };        // Jobs in all the deques
+    std::atomic<int> sleepingWaiters{ 0 };  // Threads asleep in wait(), woken whenever a job finishes
+    bool stopping = false;
+};
@@ -0,0 +1,210 @@
+#include "MatrixBatch.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "CpuFeatures.h"
+
+#ifdef CUBEY_X86
+#include <immintrin.h>
+#endif
+
+const char* matrixKernelName(MatrixKernel kernel) {
+    switch (kernel) {
+    case MatrixKernel::Sse: return "SSE";
+    case MatrixKernel::Avx2: return "AVX2";
+    default: return "scalar";
+    }
+}
+
+MatrixKernel bestMatrixKernel() {
+    const CpuFeatures& cpu = cpuFeatures();
+    if (cpu.avx2 && cpu.fma) return MatrixKernel::Avx2;
+    if (cpu.sse2) return MatrixKernel::Sse;
+    return MatrixKernel::Scalar;
+}
+
+MatrixKernel supportedMatrixKernel(MatrixKernel kernel) {
+    const CpuFeatures& cpu = cpuFeatures();
+    if ((kernel == MatrixKernel::Avx2 && !(cpu.avx2 && cpu.fma)) || (kernel == MatrixKernel::Sse && !cpu.sse2))
+        return bestMatrixKernel();
+    return kernel;
+}
+
+glm::mat4 composeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    // The rotation matrix of a unit quaternion, with each column multiplied by its scale
+    float xx = rotation.x * rotation.x, yy = rotation.y * rotation.y, zz = rotation.z * rotation.z;
+    float xy = rotation.x * rotation.y, xz = rotation.x * rotation.z, yz = rotation.y * rotation.z;
+    float wx = rotation.w * rotation.x, wy = rotation.w * rotation.y, wz = rotation.w * rotation.z;
+    glm::mat4 m(1.0f);
+    m[0][0] = (1.0f - 2.0f * (yy + zz)) * scale.x;
+    m[0][1] = 2.0f * (xy + wz) * scale.x;
+    m[0][2] = 2.0f * (xz - wy) * scale.x;
+    m[1][0] = 2.0f * (xy - wz) * scale.y;
+    m[1][1] = (1.0f - 2.0f * (xx + zz)) * scale.y;
+    m[1][2] = 2.0f * (yz + wx) * scale.y;
+    m[2][0] = 2.0f * (xz + wy) * scale.z;
+    m[2][1] = 2.0f * (yz - wx) * scale.z;
+    m[2][2] = (1.0f - 2.0f * (xx + yy)) * scale.z;
+    m[3][0] = position.x;
+    m[3][1] = position.y;
+    m[3][2] = position.z;
+    return m;
+}
+
+namespace {
+    void composeScalar(const TransformArrays& in, size_t first, glm::mat4* out) {
+        for (size_t i = first; i < in.count; ++i) {
+            out[i] = composeTransform(glm::vec3(in.positionX[i], in.positionY[i], in.positionZ[i]),
+                                      glm::quat(in.rotationW[i], in.rotationX[i], in.rotationY[i], in.rotationZ[i]),
+                                      glm::vec3(in.scaleX[i], in.scaleY[i], in.scaleZ[i]));
+        }
+    }
+
+    void multiplyScalar(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+            out[i] = left * in[i];
+    }
+
+#ifdef CUBEY_X86
+    // Columns c of four transforms, given as one vector per row with a lane per transform
+    CUBEY_TARGET_SSE2 inline void storeColumns(float* out, int column, __m128 row0, __m128 row1, __m128 row2, __m128 row3) {
+        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+        _mm_storeu_ps(out + column * 4, row0);
+        _mm_storeu_ps(out + 16 + column * 4, row1);
+        _mm_storeu_ps(out + 32 + column * 4, row2);
+        _mm_storeu_ps(out + 48 + column * 4, row3);
+    }
+
+    CUBEY_TARGET_SSE2 void composeSse(const TransformArrays& in, glm::mat4* out) {
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), zero = _mm_setzero_ps();
+        size_t i = 0;
+        for (; i + 4 <= in.count; i += 4) {
+            __m128 qx = _mm_loadu_ps(in.rotationX + i), qy = _mm_loadu_ps(in.rotationY + i);
+            __m128 qz = _mm_loadu_ps(in.rotationZ + i), qw = _mm_loadu_ps(in.rotationW + i);
+            __m128 sx = _mm_loadu_ps(in.scaleX + i), sy = _mm_loadu_ps(in.scaleY + i), sz = _mm_loadu_ps(in.scaleZ + i);
+            __m128 xx = _mm_mul_ps(qx, qx), yy = _mm_mul_ps(qy, qy), zz = _mm_mul_ps(qz, qz);
+            __m128 xy = _mm_mul_ps(qx, qy), xz = _mm_mul_ps(qx, qz), yz = _mm_mul_ps(qy, qz);
+            __m128 wx = _mm_mul_ps(qw, qx), wy = _mm_mul_ps(qw, qy), wz = _mm_mul_ps(qw, qz);
+
+            float* target = glm::value_ptr(out[i]);
+            storeColumns(target, 0,
+                _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx),
+                zero);
+            storeColumns(target, 1,
+                _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy),
+                _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy),
+                zero);
+            storeColumns(target, 2,
+                _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz),
+                _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz),
+                _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz),
+                zero);
+            storeColumns(target, 3, _mm_loadu_ps(in.positionX + i), _mm_loadu_ps(in.positionY + i), _mm_loadu_ps(in.positionZ + i), one);
+        }
+        composeScalar(in, i, out);
+    }
+
+    CUBEY_TARGET_SSE2 void multiplySse(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count) {
+        const __m128 l0 = _mm_loadu_ps(glm::value_ptr(left)), l1 = _mm_loadu_ps(glm::value_ptr(left) + 4);
+        const __m128 l2 = _mm_loadu_ps(glm::value_ptr(left) + 8), l3 = _mm_loadu_ps(glm::value_ptr(left) + 12);
+        for (size_t i = 0; i < count; ++i) {
+            const float* source = glm::value_ptr(in[i]);
+            float* target = glm::value_ptr(out[i]);
+            // Each result column is the left matrix's columns weighted by the input column
+            for (int column = 0; column < 4; ++column) {
+                __m128 v = _mm_loadu_ps(source + column * 4);
+                __m128 r = _mm_mul_ps(l0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+                r = _mm_add_ps(r, _mm_mul_ps(l1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+                r = _mm_add_ps(r, _mm_mul_ps(l2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+                r = _mm_add_ps(r, _mm_mul_ps(l3, _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))));
+                _mm_storeu_ps(target + column * 4, r);
+            }
+        }
+    }
+
+    // Columns c of eight transforms: the low halves hold transforms 0 to 3, the high halves 4 to 7
+    CUBEY_TARGET_AVX2_FMA inline void storeColumns8(float* out, int column, __m256 row0, __m256 row1, __m256 row2, __m256 row3) {
+        storeColumns(out, column, _mm256_castps256_ps128(row0), _mm256_castps256_ps128(row1),
+                     _mm256_castps256_ps128(row2), _mm256_castps256_ps128(row3));
+        storeColumns(out + 64, column, _mm256_extractf128_ps(row0, 1), _mm256_extractf128_ps(row1, 1),
+                     _mm256_extractf128_ps(row2, 1), _mm256_extractf128_ps(row3, 1));
+    }
+
+    CUBEY_TARGET_AVX2_FMA void composeAvx2(const TransformArrays& in, glm::mat4* out) {
+        const __m256 one = _mm256_set1_ps(1.0f), two = _mm256_set1_ps(2.0f), zero = _mm256_setzero_ps();
+        size_t i = 0;
+        for (; i + 8 <= in.count; i += 8) {
+            __m256 qx = _mm256_loadu_ps(in.rotationX + i), qy = _mm256_loadu_ps(in.rotationY + i);
+            __m256 qz = _mm256_loadu_ps(in.rotationZ + i), qw = _mm256_loadu_ps(in.rotationW + i);
+            __m256 sx = _mm256_loadu_ps(in.scaleX + i), sy = _mm256_loadu_ps(in.scaleY + i), sz = _mm256_loadu_ps(in.scaleZ + i);
+            // Twice the products, so each entry is one add or subtract away
+            __m256 x2 = _mm256_mul_ps(two, qx), y2 = _mm256_mul_ps(two, qy), z2 = _mm256_mul_ps(two, qz);
+            __m256 xx = _mm256_mul_ps(qx, x2), yy = _mm256_mul_ps(qy, y2), zz = _mm256_mul_ps(qz, z2);
+            __m256 xy = _mm256_mul_ps(qx, y2), xz = _mm256_mul_ps(qx, z2), yz = _mm256_mul_ps(qy, z2);
+            __m256 wx = _mm256_mul_ps(qw, x2), wy = _mm256_mul_ps(qw, y2), wz = _mm256_mul_ps(qw, z2);
+
+            float* target = glm::value_ptr(out[i]);
+            storeColumns8(target, 0,
+                _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx),
+                _mm256_mul_ps(_mm256_add_ps(xy, wz), sx),
+                _mm256_mul_ps(_mm256_sub_ps(xz, wy), sx),
+                zero);
+            storeColumns8(target, 1,
+                _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy),
+                _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy),
+                _mm256_mul_ps(_mm256_add_ps(yz, wx), sy),
+                zero);
+            storeColumns8(target, 2,
+                _mm256_mul_ps(_mm256_add_ps(xz, wy), sz),
+                _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz),
+                _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz),
+                zero);
+            storeColumns8(target, 3, _mm256_loadu_ps(in.positionX + i), _mm256_loadu_ps(in.positionY + i), _mm256_loadu_ps(in.positionZ + i), one);
+        }
+        composeScalar(in, i, out);
+    }
+
+    CUBEY_TARGET_AVX2_FMA void multiplyAvx2(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count) {
+        // The left matrix's columns in both halves, so two input columns are handled at once
+        const __m256 l0 = _mm256_broadcast_ps((const __m128*)glm::value_ptr(left)), l1 = _mm256_broadcast_ps((const __m128*)(glm::value_ptr(left) + 4));
+        const __m256 l2 = _mm256_broadcast_ps((const __m128*)(glm::value_ptr(left) + 8)), l3 = _mm256_broadcast_ps((const __m128*)(glm::value_ptr(left) + 12));
+        for (size_t i = 0; i < count; ++i) {
+            const float* source = glm::value_ptr(in[i]);
+            float* target = glm::value_ptr(out[i]);
+            for (int column = 0; column < 4; column += 2) {
+                __m256 v = _mm256_loadu_ps(source + column * 4);
+                __m256 r = _mm256_mul_ps(l0, _mm256_permute_ps(v, 0x00));
+                r = _mm256_fmadd_ps(l1, _mm256_permute_ps(v, 0x55), r);
+                r = _mm256_fmadd_ps(l2, _mm256_permute_ps(v, 0xAA), r);
+                r = _mm256_fmadd_ps(l3, _mm256_permute_ps(v, 0xFF), r);
+                _mm256_storeu_ps(target + column * 4, r);
+            }
+        }
+    }
+#endif
+}
+
+void composeTransforms(const TransformArrays& transforms, glm::mat4* out, MatrixKernel kernel) {
+#ifdef CUBEY_X86
+    switch (supportedMatrixKernel(kernel)) {
+    case MatrixKernel::Avx2: composeAvx2(transforms, out); return;
+    case MatrixKernel::Sse: composeSse(transforms, out); return;
+    default: break;
+    }
+#endif
+    composeScalar(transforms, 0, out);
+}
+
+void multiplyTransforms(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count, MatrixKernel kernel) {
+#ifdef CUBEY_X86
+    switch (supportedMatrixKernel(kernel)) {
+    case MatrixKernel::Avx2: multiplyAvx2(left, in, out, count); return;
+    case MatrixKernel::Sse: multiplySse(left, in, out, count); return;
+    default: break;
+    }
+#endif
+    multiplyScalar(left, in, out, count);
+}
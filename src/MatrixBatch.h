@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// --- Batched matrix math ---
+// Builds model matrices from structure-of-arrays position, rotation quaternion and scale inputs,
+// and multiplies runs of matrices by one matrix (such as the view-projection), with SSE and AVX2
+// kernels picked at runtime from what the CPU supports. Composing works across transforms: each
+// SIMD lane holds one transform, so four or eight are built per pass and then transposed into
+// column-major glm::mat4s. Multiplying works within a matrix instead, four floats of a column (SSE)
+// or two whole columns (AVX2) per instruction, one matrix at a time. Its inputs are already
+// column-major matrices, not component arrays, and with one left matrix shared by all of them a
+// lane per matrix only adds a transpose on the way in and out: MatrixBench measured such kernels at
+// half the speed of these. Cubey itself applies the view-projection in the vertex shaders, so
+// multiplyTransforms() is for callers that need matrices on the CPU, and for MatrixBench.
+
+enum class MatrixKernel {
+    Scalar,
+    Sse,    // Four transforms at a time
+    Avx2    // Eight transforms at a time, with FMA
+};
+const char* matrixKernelName(MatrixKernel kernel);
+// The widest kernel this CPU supports
+MatrixKernel bestMatrixKernel();
+// kernel, or the best supported one if the CPU lacks it
+MatrixKernel supportedMatrixKernel(MatrixKernel kernel);
+
+// count transforms, one array per component. Rotations must be unit quaternions.
+struct TransformArrays {
+    const float* positionX;
+    const float* positionY;
+    const float* positionZ;
+    const float* rotationX;
+    const float* rotationY;
+    const float* rotationZ;
+    const float* rotationW;
+    const float* scaleX;
+    const float* scaleY;
+    const float* scaleZ;
+    size_t count;
+};
+
+// The local matrix of a transform: scale, then rotate, then translate
+glm::mat4 composeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+// The same for each of the transforms, into out[0, transforms.count)
+void composeTransforms(const TransformArrays& transforms, glm::mat4* out, MatrixKernel kernel);
+// out[i] = left * in[i] for count matrices. out may be in.
+void multiplyTransforms(const glm::mat4& left, const glm::mat4* in, glm::mat4* out, size_t count, MatrixKernel kernel);
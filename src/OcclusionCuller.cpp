@@ -0,0 +1,153 @@
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "GlState.h"
+
+void OcclusionCuller::destroy() {
+    for (Capture& capture : captures) {
+        glState.deleteBuffers(1, &capture.buffer);
+        capture = Capture();
+    }
+    nextCapture = 0;
+    levels.clear();
+    pyramidReady = false;
+}
+
+void OcclusionCuller::captureDepth(int width, int height, const glm::mat4& viewProjection) {
+    if (width <= 0 || height <= 0)
+        return;
+    Capture& capture = captures[nextCapture];
+    nextCapture = (nextCapture + 1) % CaptureCount;
+    size_t size = (size_t)width * height * sizeof(float);
+    if (capture.buffer == 0)
+        glGenBuffers(1, &capture.buffer);
+    glState.bindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffer);
+    if (capture.bufferSize != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        capture.bufferSize = size;
+    }
+    // Into the pixel buffer, so the call returns before the copy is done
+    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, (void*)0);
+    glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    capture.width = width;
+    capture.height = height;
+    capture.viewProjection = viewProjection;
+    capture.pending = true;
+}
+
+void OcclusionCuller::invalidate() {
+    for (Capture& capture : captures)
+        capture.pending = false;
+    pyramidReady = false;
+}
+
+bool OcclusionCuller::buildPyramid() {
+    // The oldest capture, the next one to be overwritten
+    Capture& capture = captures[nextCapture];
+    if (!capture.pending)
+        return false;
+    capture.pending = false;
+    glState.bindBuffer(GL_PIXEL_PACK_BUFFER, capture.buffer);
+    const float* depth = static_cast<const float*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, capture.bufferSize, GL_MAP_READ_BIT));
+    if (!depth) {
+        std::cerr << "Failed to map the occlusion depth buffer" << std::endl;
+        glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return false;
+    }
+
+    // Halve until 1x1. Odd sizes round up, and the last row or column then only reduces what is there.
+    size_t levelCount = 0;
+    for (int w = capture.width, h = capture.height; w > 1 || h > 1; w = (w + 1) / 2, h = (h + 1) / 2)
+        ++levelCount;
+    levels.resize(std::max<size_t>(levelCount, 1));
+
+    int sourceWidth = capture.width, sourceHeight = capture.height;
+    const float* source = depth;
+    for (Level& level : levels) {
+        level.width = (sourceWidth + 1) / 2;
+        level.height = (sourceHeight + 1) / 2;
+        level.depth.resize((size_t)level.width * level.height);
+        for (int y = 0; y < level.height; ++y) {
+            const float* row0 = source + (size_t)(2 * y) * sourceWidth;
+            const float* row1 = source + (size_t)std::min(2 * y + 1, sourceHeight - 1) * sourceWidth;
+            float* target = level.depth.data() + (size_t)y * level.width;
+            for (int x = 0; x < level.width; ++x) {
+                int x0 = 2 * x, x1 = std::min(2 * x + 1, sourceWidth - 1);
+                target[x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+            }
+        }
+        sourceWidth = level.width;
+        sourceHeight = level.height;
+        source = level.depth.data();
+    }
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glState.bindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    pyramidWidth = capture.width;
+    pyramidHeight = capture.height;
+    pyramidViewProjection = capture.viewProjection;
+    return true;
+}
+
+bool OcclusionCuller::occluded(const glm::vec3& center, const glm::vec3& halfSize) const {
+    // The corners in clip space: the center plus or minus each of the box's projected half edges
+    const glm::mat4& m = pyramidViewProjection;
+    glm::vec4 clipCenter = m * glm::vec4(center, 1.0f);
+    glm::vec4 edges[3] = { m[0] * halfSize.x, m[1] * halfSize.y, m[2] * halfSize.z };
+    float minX = 1.0f, maxX = -1.0f, minY = 1.0f, maxY = -1.0f, minZ = 1.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        glm::vec4 p = clipCenter;
+        for (int axis = 0; axis < 3; ++axis)
+            p += (corner & (1 << axis)) ? edges[axis] : -edges[axis];
+        if (p.w <= 1e-5f)
+            return false; // Reaches behind the camera, the projection is unbounded
+        float inverseW = 1.0f / p.w;
+        minX = std::min(minX, p.x * inverseW);
+        maxX = std::max(maxX, p.x * inverseW);
+        minY = std::min(minY, p.y * inverseW);
+        maxY = std::max(maxY, p.y * inverseW);
+        minZ = std::min(minZ, p.z * inverseW);
+    }
+
+    // The rectangle in level 0 texels, two framebuffer pixels each. glReadPixels rows start at the bottom like NDC.
+    const Level& base = levels[0];
+    float scaleX = pyramidWidth * 0.25f, scaleY = pyramidHeight * 0.25f;
+    int x0 = std::max(0, (int)std::floor((minX + 1.0f) * scaleX));
+    int x1 = std::min(base.width - 1, (int)std::floor((maxX + 1.0f) * scaleX));
+    int y0 = std::max(0, (int)std::floor((minY + 1.0f) * scaleY));
+    int y1 = std::min(base.height - 1, (int)std::floor((maxY + 1.0f) * scaleY));
+    if (x0 > x1 || y0 > y1)
+        return false; // Off screen back then, nothing to compare with
+
+    size_t level = 0;
+    while (level + 1 < levels.size() && ((x1 >> level) - (x0 >> level) > 1 || (y1 >> level) - (y0 >> level) > 1))
+        ++level;
+    const Level& texels = levels[level];
+    float farthest = 0.0f;
+    for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (int x = x0 >> level; x <= (x1 >> level); ++x)
+            farthest = std::max(farthest, texels.depth[(size_t)y * texels.width + x]);
+    }
+    float nearest = minZ * 0.5f + 0.5f; // The default depth range maps NDC [-1, 1] to [0, 1]
+    return nearest > farthest;
+}
+
+size_t OcclusionCuller::cull(const FrustumCuller& boxes, uint32_t* visible, size_t visibleCount) {
+    pyramidReady = buildPyramid();
+    lastStats = OcclusionStats();
+    if (!pyramidReady)
+        return visibleCount;
+
+    size_t kept = 0;
+    for (size_t i = 0; i < visibleCount; ++i) {
+        uint32_t box = visible[i];
+        if (!occluded(boxes.center(box), boxes.halfSize(box)))
+            visible[kept++] = box;
+    }
+    lastStats.tested = visibleCount;
+    lastStats.occluded = visibleCount - kept;
+    return kept;
+}
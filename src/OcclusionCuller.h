@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "FrustumCuller.h"
+
+// --- Hierarchical-Z occlusion culling ---
+// Culls boxes hidden behind what an earlier frame drew. After the occluders are drawn, the depth
+// buffer is copied into a pixel buffer without waiting for it, and when the copy comes back two
+// frames later a depth pyramid (Hi-Z) is built from it on the CPU: every level halves the one
+// below and keeps the farthest depth of the texels it covers. A box is projected with the matrix
+// that frame was drawn with, and at the level where its screen rectangle spans at most 2x2 texels,
+// four reads give the farthest depth behind the whole rectangle. When the nearest corner of the
+// box is farther still, the box was hidden.
+// The depth is two frames old, so a cube coming out from behind another can show up that much late.
+
+struct OcclusionStats {
+    size_t tested = 0;   // Boxes tested, those that passed frustum culling
+    size_t occluded = 0; // Of those, boxes found hidden
+};
+
+class OcclusionCuller {
+public:
+    void destroy();
+
+    // Start copying the depth buffer of the width x height framebuffer. viewProjection maps box
+    // coordinates to that frame's clip space. Call after the occluders are drawn.
+    void captureDepth(int width, int height, const glm::mat4& viewProjection);
+    // Drop captures in flight, when frames went by without one and their depth no longer matches
+    void invalidate();
+
+    // Build the pyramid from the oldest capture, if it is in, and remove the boxes it hides from
+    // visible, keeping the order of the rest. Returns how many are left.
+    size_t cull(const FrustumCuller& boxes, uint32_t* visible, size_t visibleCount);
+
+    // Whether the last cull() had a pyramid to test against
+    bool ready() const { return pyramidReady; }
+    const OcclusionStats& stats() const { return lastStats; }
+
+private:
+    struct Capture {
+        GLuint buffer = 0;
+        size_t bufferSize = 0;
+        int width = 0, height = 0;
+        glm::mat4 viewProjection;
+        bool pending = false;
+    };
+    struct Level {
+        int width = 0, height = 0;
+        std::vector<float> depth;
+    };
+    static const int CaptureCount = 2; // Frames between a capture and its use
+
+    bool buildPyramid();
+    bool occluded(const glm::vec3& center, const glm::vec3& halfSize) const;
+
+    Capture captures[CaptureCount];
+    int nextCapture = 0;
+    std::vector<Level> levels; // Level 0 is half the framebuffer size
+    int pyramidWidth = 0, pyramidHeight = 0; // Framebuffer size of the pyramid
+    glm::mat4 pyramidViewProjection;
+    bool pyramidReady = false;
+    OcclusionStats lastStats;
+};
@@ -0,0 +1,193 @@
+#include "ProgramBinaryCache.h"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <system_error>
+#include <vector>
+
+#include "GlState.h"
+
+// Tokens and entry points of ARB_get_program_binary / OpenGL 4.1
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+
+namespace {
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+
+    // File header in front of the driver's binary
+    struct BinaryFileHeader {
+        char magic[4];
+        uint32_t binaryFormat;
+        uint64_t key;
+        uint32_t length;
+        uint32_t reserved;
+    };
+    const char BinaryFileMagic[4] = { 'C', 'B', 'P', 'B' };
+
+    // FNV-1a, continued from hash
+    uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Strings are hashed with their terminator so "ab" + "c" and "a" + "bc" differ
+    uint64_t hashString(uint64_t hash, const char* text) {
+        return hashBytes(hash, text, std::strlen(text) + 1);
+    }
+
+    const char* glString(GLenum name) {
+        const GLubyte* value = glGetString(name);
+        return value ? reinterpret_cast<const char*>(value) : "";
+    }
+}
+
+bool ProgramBinaryCache::init(const std::string& cacheDirectory, GLADloadproc loadProc) {
+    active = false;
+    if (cacheDirectory.empty())
+        return false;
+
+    bool supported = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 1);
+    GLint extensionCount = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+    for (GLint i = 0; i < extensionCount && !supported; ++i) {
+        const GLubyte* extension = glGetStringi(GL_EXTENSIONS, i);
+        supported = extension && std::strcmp(reinterpret_cast<const char*>(extension), "GL_ARB_get_program_binary") == 0;
+    }
+    if (supported) {
+        getProgramBinary = (GetProgramBinaryProc)loadProc("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc)loadProc("glProgramBinary");
+        programParameteri = (ProgramParameteriProc)loadProc("glProgramParameteri");
+    }
+    GLint formatCount = 0;
+    if (supported)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if (!getProgramBinary || !programBinary || !programParameteri || formatCount == 0) {
+        std::cout << "Program binary cache: not supported by this driver" << std::endl;
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectory, error);
+    if (error) {
+        std::cerr << "Failed to create program binary cache directory " << cacheDirectory << ": " << error.message() << std::endl;
+        return false;
+    }
+    directory = cacheDirectory;
+    driver = std::string(glString(GL_VENDOR)) + '\n' + glString(GL_RENDERER) + '\n' + glString(GL_VERSION);
+    counters = ProgramBinaryCacheStats();
+    active = true;
+    return true;
+}
+
+uint64_t ProgramBinaryCache::makeKey(const char* vertexSource, const char* fragmentSource, const std::string& defines) const {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash = hashString(hash, driver.c_str());
+    hash = hashString(hash, defines.c_str());
+    hash = hashString(hash, vertexSource);
+    hash = hashString(hash, fragmentSource);
+    return hash;
+}
+
+std::string ProgramBinaryCache::pathFor(uint64_t key) const {
+    return (std::filesystem::path(directory) / std::format("{:016x}.bin", key)).string();
+}
+
+void ProgramBinaryCache::prepareForLink(GLuint program) const {
+    if (active)
+        programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+}
+
+GLuint ProgramBinaryCache::load(uint64_t key) {
+    if (!active)
+        return 0;
+    std::string path = pathFor(key);
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file)
+        return 0;
+    BinaryFileHeader header;
+    std::vector<unsigned char> binary;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+              && std::memcmp(header.magic, BinaryFileMagic, sizeof(header.magic)) == 0
+              && header.key == key && header.length > 0;
+    if (valid) {
+        binary.resize(header.length);
+        valid = fread(binary.data(), 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+
+    GLuint program = 0;
+    if (valid) {
+        program = glCreateProgram();
+        programBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            glState.deleteProgram(program);
+            program = 0;
+        }
+    }
+    if (!program) {
+        // Corrupt, or made by a driver that no longer accepts it. Compile from source and replace it.
+        std::remove(path.c_str());
+        counters.rejected++;
+        return 0;
+    }
+    counters.loaded++;
+    return program;
+}
+
+void ProgramBinaryCache::store(uint64_t key, GLuint program) {
+    if (!active)
+        return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<unsigned char> binary(length);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    getProgramBinary(program, length, &written, &binaryFormat, binary.data());
+    if (written <= 0)
+        return;
+
+    BinaryFileHeader header;
+    std::memcpy(header.magic, BinaryFileMagic, sizeof(header.magic));
+    header.binaryFormat = binaryFormat;
+    header.key = key;
+    header.length = (uint32_t)written;
+    header.reserved = 0;
+
+    // Write to a temporary name first so an interrupted write never leaves a truncated binary behind
+    std::string path = pathFor(key);
+    std::string temporaryPath = path + ".tmp";
+    FILE* file = fopen(temporaryPath.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Failed to write program binary: " << temporaryPath << std::endl;
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(binary.data(), 1, written, file) == (size_t)written;
+    ok = fclose(file) == 0 && ok;
+    std::error_code error;
+    if (ok)
+        std::filesystem::rename(temporaryPath, path, error);
+    if (!ok || error) {
+        std::remove(temporaryPath.c_str());
+        std::cerr << "Failed to write program binary: " << path << std::endl;
+        return;
+    }
+    counters.stored++;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+// --- Program binary cache ---
+// Stores linked programs on disk with glGetProgramBinary and loads them back with glProgramBinary,
+// skipping GLSL compilation and linking on later runs. Program binaries are core in OpenGL 4.1 and
+// available on older contexts through ARB_get_program_binary. Our glad loader only covers 3.3, so the
+// entry points are resolved here. A binary is keyed by its sources, defines and the driver that
+// produced it, and a binary that fails to load is deleted so the program is compiled again.
+
+struct ProgramBinaryCacheStats {
+    int loaded = 0;   // Programs created from a cached binary
+    int stored = 0;   // Programs compiled and written to the cache
+    int rejected = 0; // Cached binaries the driver refused, typically after a driver update
+};
+
+class ProgramBinaryCache {
+public:
+    // Enable the cache in directory if the context supports program binaries.
+    // loadProc resolves GL entry points, like the one passed to gladLoadGLLoader.
+    bool init(const std::string& directory, GLADloadproc loadProc);
+    bool enabled() const { return active; }
+
+    // Key of a program built from these sources and defines by the current driver
+    uint64_t makeKey(const char* vertexSource, const char* fragmentSource, const std::string& defines) const;
+
+    // Call on a new program before linking it, so its binary can be retrieved afterwards
+    void prepareForLink(GLuint program) const;
+    // Create a linked program from the binary stored under key. Returns 0 on a miss or a rejected binary.
+    GLuint load(uint64_t key);
+    // Save the binary of a successfully linked program under key
+    void store(uint64_t key, GLuint program);
+
+    const ProgramBinaryCacheStats& stats() const { return counters; }
+
+private:
+    std::string pathFor(uint64_t key) const;
+
+    bool active = false;
+    std::string directory;
+    std::string driver; // Vendor, renderer and version, part of every key
+    ProgramBinaryCacheStats counters;
+};
@@ -0,0 +1,93 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "GlState.h"
+
+uint64_t RenderQueue::sortKey(unsigned layer, GLuint program, GLuint texture, GLuint vertexArray, float depth) {
+    const uint64_t depthMax = (1u << DepthBits) - 1;
+    uint64_t depthBits = (uint64_t)std::lround(std::clamp(depth, 0.0f, 1.0f) * (float)depthMax);
+    uint64_t key = layer & ((1u << LayerBits) - 1);
+    key = key << ProgramBits | (program & ((1u << ProgramBits) - 1));
+    key = key << TextureBits | (texture & ((1u << TextureBits) - 1));
+    key = key << VertexArrayBits | (vertexArray & ((1u << VertexArrayBits) - 1));
+    return key << DepthBits | depthBits;
+}
+
+void RenderQueue::submit(uint64_t key, const DrawItem& item) {
+    entries.push_back({ key, (uint32_t)items.size() });
+    items.push_back(item);
+}
+
+void RenderQueue::sort() {
+    // Least significant digit first, a byte per pass. Each pass is stable, so draws with equal keys
+    // keep the order they were submitted in. All eight histograms come from one read of the keys,
+    // and a pass whose byte is the same in every key is skipped.
+    const size_t count = entries.size();
+    size_t histograms[8][256] = {};
+    for (const SortEntry& entry : entries) {
+        for (int digit = 0; digit < 8; ++digit)
+            histograms[digit][(entry.key >> (digit * 8)) & 0xFF]++;
+    }
+    scratch.resize(count);
+    for (int digit = 0; digit < 8; ++digit) {
+        size_t* histogram = histograms[digit];
+        if (histogram[(entries[0].key >> (digit * 8)) & 0xFF] == count)
+            continue;
+        size_t offset = 0;
+        for (int bucket = 0; bucket < 256; ++bucket) {
+            size_t bucketCount = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += bucketCount;
+        }
+        for (const SortEntry& entry : entries)
+            scratch[histogram[(entry.key >> (digit * 8)) & 0xFF]++] = entry;
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::flush() {
+    if (items.empty())
+        return;
+    sort();
+
+    // glState drops the binds the draw before already made; what it lets through is counted here
+    for (const SortEntry& entry : entries) {
+        const DrawItem& item = items[entry.item];
+        if (glState.useProgram(item.program))
+            stats.programChanges++;
+        if (item.texture != 0 && glState.bindTexture(item.textureTarget, item.texture))
+            stats.textureChanges++;
+        if (glState.bindVertexArray(item.vertexArray))
+            stats.vertexArrayChanges++;
+
+        const void* firstIndex = (const void*)((size_t)item.first * (item.indexType == GL_UNSIGNED_INT ? 4 : item.indexType == GL_UNSIGNED_SHORT ? 2 : 1));
+        switch (item.kind) {
+        case DrawKind::Arrays:
+            glDrawArrays(item.mode, item.first, item.count);
+            break;
+        case DrawKind::Elements:
+            glDrawElements(item.mode, item.count, item.indexType, firstIndex);
+            break;
+        case DrawKind::ArraysInstanced:
+            glDrawArraysInstanced(item.mode, item.first, item.count, item.instances);
+            break;
+        case DrawKind::ElementsInstanced:
+            glDrawElementsInstanced(item.mode, item.count, item.indexType, firstIndex, item.instances);
+            break;
+        case DrawKind::Custom:
+            item.custom(item, item.context);
+            break;
+        }
+        stats.draws++;
+    }
+    items.clear();
+    entries.clear();
+}
+
+RenderQueueStats RenderQueue::resetStats() {
+    RenderQueueStats result = stats;
+    stats = RenderQueueStats();
+    return result;
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+// --- Render queue ---
+// Draws are submitted as a 64-bit sort key plus a DrawItem naming the program, texture and vertex
+// array they need. flush() sorts them by key with a radix sort and issues them in that order
+// through glState, which drops the binds that match the draw before, so draws that share state end
+// up side by side and share its binds. From the most significant bit down, a key holds:
+//  - the layer, for passes that must stay in order, such as the scene before the overlay,
+//  - the program, the most expensive state to change,
+//  - the texture and the vertex array,
+//  - a depth, so draws with the same state go front to back.
+// Object names are folded into their fields, so two programs can share a key field. That only
+// costs a state change, since glState compares the real objects and not their key bits.
+
+enum class DrawKind : uint8_t {
+    Arrays,            // glDrawArrays(mode, first, count)
+    Elements,          // glDrawElements(mode, count, indexType, first index)
+    ArraysInstanced,
+    ElementsInstanced,
+    Custom             // custom(item, context), for draws the kinds above can't describe
+};
+
+struct DrawItem {
+    GLuint program = 0;
+    GLuint vertexArray = 0;
+    GLenum textureTarget = GL_TEXTURE_2D;
+    GLuint texture = 0;      // Bound to unit 0, which must be the active unit. 0 for draws that sample nothing.
+    DrawKind kind = DrawKind::Arrays;
+    GLenum mode = GL_TRIANGLES;
+    GLint first = 0;         // First vertex, or first index for indexed draws
+    GLsizei count = 0;
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    GLsizei instances = 1;
+    // Custom draws, called with the program, texture and vertex array above bound. context must
+    // stay valid until the queue is flushed.
+    void (*custom)(const DrawItem& item, const void* context) = nullptr;
+    const void* context = nullptr;
+};
+
+// Counted across flushes until resetStats(). A change is a bind glState passed on to GL.
+struct RenderQueueStats {
+    int draws = 0;
+    int programChanges = 0;
+    int textureChanges = 0;
+    int vertexArrayChanges = 0;
+};
+
+class RenderQueue {
+public:
+    static const int LayerBits = 4;
+    static const int ProgramBits = 12;
+    static const int TextureBits = 12;
+    static const int VertexArrayBits = 12;
+    static const int DepthBits = 24;
+
+    // depth runs from 0, drawn first, to 1. Pass 1 - depth for back to front order.
+    static uint64_t sortKey(unsigned layer, GLuint program, GLuint texture, GLuint vertexArray, float depth);
+
+    void submit(uint64_t key, const DrawItem& item);
+    // Sort and issue everything submitted since the last flush. The program, texture and vertex array
+    // of the last draw stay bound.
+    void flush();
+    size_t size() const { return items.size(); }
+
+    // Return the counters gathered since the previous call and start counting again
+    RenderQueueStats resetStats();
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t item;
+    };
+    void sort();
+
+    std::vector<DrawItem> items;
+    std::vector<SortEntry> entries, scratch; // Reused from flush to flush
+    RenderQueueStats stats;
+};
@@ -0,0 +1,99 @@
+#include "RenderThread.h"
+
+#include <GLFW/glfw3.h>
+
+void CommandRing::init(size_t capacityBytes) {
+    size_t capacity = MaxCommandBytes * 2;
+    while (capacity < capacityBytes)
+        capacity *= 2;
+    buffer.assign(capacity, 0);
+    mask = capacity - 1;
+    writePosition = readPosition = 0;
+    written = 0;
+    read = 0;
+}
+
+unsigned char* CommandRing::reserve(size_t size) {
+    const size_t capacity = mask + 1;
+    size_t offset = writePosition & mask;
+    size_t padding = offset + size > capacity ? capacity - offset : 0;
+    // Wait for the consumer to free enough room, padding included
+    for (size_t seen = read.load(std::memory_order_acquire); capacity - (writePosition - seen) < padding + size;
+         seen = read.load(std::memory_order_acquire))
+        read.wait(seen, std::memory_order_acquire);
+    if (padding > 0) {
+        Header* header = new (&buffer[offset]) Header;
+        header->invoke = nullptr;
+        header->size = (uint32_t)padding;
+        commit(padding);
+        offset = 0;
+    }
+    return &buffer[offset];
+}
+
+void CommandRing::commit(size_t size) {
+    writePosition += size;
+    written.store(writePosition, std::memory_order_release);
+    written.notify_one();
+}
+
+bool CommandRing::runOne() {
+    if (written.load(std::memory_order_acquire) == readPosition)
+        return false;
+    const Header* header = reinterpret_cast<const Header*>(&buffer[readPosition & mask]);
+    if (header->invoke)
+        header->invoke(header + 1);
+    readPosition += header->size;
+    read.store(readPosition, std::memory_order_release);
+    read.notify_one();
+    return true;
+}
+
+void CommandRing::waitForCommand() {
+    written.wait(readPosition, std::memory_order_acquire);
+}
+
+void RenderThread::start(GLFWwindow* window, unsigned frameQueueDepth, bool threaded, size_t ringBytes) {
+    stop();
+    this->window = window;
+    depth = frameQueueDepth > 0 ? frameQueueDepth : 1;
+    framesBegun = 0;
+    framesFinished = 0;
+    if (!threaded)
+        return;
+    ring.init(ringBytes);
+    stopping = false;
+    glfwMakeContextCurrent(NULL); // A context is current on one thread at a time
+    thread = std::thread([this] { run(); });
+}
+
+void RenderThread::stop() {
+    if (!threaded())
+        return;
+    push([this] { stopping = true; });
+    thread.join();
+    glfwMakeContextCurrent(window);
+}
+
+void RenderThread::run() {
+    glfwMakeContextCurrent(window);
+    while (!stopping) {
+        if (!ring.runOne())
+            ring.waitForCommand();
+    }
+    glfwMakeContextCurrent(NULL);
+}
+
+unsigned RenderThread::beginFrame() {
+    for (uint64_t finished = framesFinished.load(std::memory_order_acquire); framesBegun - finished >= depth;
+         finished = framesFinished.load(std::memory_order_acquire))
+        framesFinished.wait(finished, std::memory_order_acquire);
+    return (unsigned)(framesBegun++ % depth);
+}
+
+void RenderThread::endFrame() {
+    push([this] {
+        framesFinished.fetch_add(1, std::memory_order_release);
+        framesFinished.notify_one();
+    });
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+struct GLFWwindow;
+
+// --- Render command ring ---
+// A lock-free ring of commands from one producer thread to one consumer thread. A command is any
+// trivially copyable callable, such as a lambda that captures references and plain values. It is
+// copied into the ring behind a 16 byte header that holds its size and a function that calls it,
+// so the stream is compact binary data with no allocation per command. The producer and consumer
+// each own one counter of bytes written or read, and only wait on each other when the ring is full
+// or empty.
+
+class CommandRing {
+public:
+    // Largest command that can be pushed, header included
+    static const size_t MaxCommandBytes = 256;
+
+    // capacityBytes is rounded up to a power of two
+    void init(size_t capacityBytes);
+
+    // Producer: copy command into the ring, waiting while it is full
+    template <typename Command>
+    void push(const Command& command);
+
+    // Consumer: run the next command, or return false if there is none
+    bool runOne();
+    // Consumer: wait until there is a command to run
+    void waitForCommand();
+
+private:
+    struct Header {
+        void (*invoke)(const void* command); // Null for padding up to the end of the ring
+        uint32_t size;                       // Of the header and the command, rounded up to 16 bytes
+    };
+    static_assert(sizeof(Header) <= 16, "The header must fit in 16 bytes");
+
+    template <typename Command>
+    static void invoke(const void* command) { (*static_cast<const Command*>(command))(); }
+    // Wait for room for size bytes, padding to the start of the ring if they would straddle its end,
+    // and return where they go
+    unsigned char* reserve(size_t size);
+    void commit(size_t size);
+
+    std::vector<unsigned char> buffer; // Stored as 16 byte aligned blocks
+    size_t mask = 0;
+    size_t writePosition = 0; // Producer's copy of written
+    size_t readPosition = 0;  // Consumer's copy of read
+    alignas(64) std::atomic<size_t> written{ 0 }; // Bytes ever written, on their own cache lines
+    alignas(64) std::atomic<size_t> read{ 0 };
+};
+
+template <typename Command>
+void CommandRing::push(const Command& command) {
+    static_assert(std::is_trivially_copyable_v<Command>, "Commands are copied as bytes");
+    static_assert(alignof(Command) <= 16, "Commands are stored 16 byte aligned");
+    const size_t size = (16 + sizeof(Command) + 15) & ~(size_t)15;
+    static_assert((16 + sizeof(Command) + 15) / 16 * 16 <= MaxCommandBytes, "Command too large for the ring");
+    unsigned char* record = reserve(size);
+    Header* header = new (record) Header;
+    header->invoke = &CommandRing::invoke<Command>;
+    header->size = (uint32_t)size;
+    new (record + 16) Command(command);
+    commit(size);
+}
+
+// --- Render thread ---
+// Owns the GL context while the main loop runs, so the main thread can simulate and cull frame
+// N + 1 while frame N is being submitted and swapped. The main thread pushes commands, and the
+// render thread runs them in order. Big per-frame data doesn't go through the ring: it lives in one
+// of frameQueueDepth frame slots, and commands refer to their slot. beginFrame() hands out the next
+// slot once the render thread has finished the frame that last used it, which bounds how far the
+// main thread can run ahead. Without a thread of its own, every command runs as soon as it is
+// pushed, on the calling thread, and the loop behaves as if single threaded.
+
+class RenderThread {
+public:
+    ~RenderThread() { stop(); }
+
+    // Move window's GL context, current on the calling thread, to a new thread if threaded is set
+    void start(GLFWwindow* window, unsigned frameQueueDepth, bool threaded, size_t ringBytes = 64 * 1024);
+    // Run everything pushed so far, end the thread and make the context current on the calling thread again
+    void stop();
+    bool threaded() const { return thread.joinable(); }
+    unsigned frameQueueDepth() const { return depth; }
+
+    template <typename Command>
+    void push(const Command& command) {
+        if (threaded())
+            ring.push(command);
+        else
+            command();
+    }
+
+    // Wait until the render thread is done with the frame slot the next frame reuses, and return it
+    unsigned beginFrame();
+    // Queue the end of the frame begun last: once the render thread gets here, its slot is free again
+    void endFrame();
+
+private:
+    void run();
+
+    CommandRing ring;
+    std::thread thread;
+    GLFWwindow* window = nullptr;
+    unsigned depth = 1;
+    uint64_t framesBegun = 0;               // Main thread only
+    std::atomic<uint64_t> framesFinished{ 0 }; // Advanced by the render thread
+    bool stopping = false;                  // Render thread only, set by the command stop() pushes
+};
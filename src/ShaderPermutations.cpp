@@ -0,0 +1,53 @@
+#include "ShaderPermutations.h"
+
+#include <iostream>
+
+namespace {
+    const char* const FeatureDefines[ShaderFeatureCount] = { "TEXTURED", "VERTEX_COLOR", "INSTANCED", "PROCEDURAL", "FEEDBACK" };
+}
+
+std::string shaderFeatureDefines(uint32_t features) {
+    std::string defines;
+    for (int i = 0; i < ShaderFeatureCount; ++i) {
+        if (features & (1u << i))
+            defines += std::string("#define ") + FeatureDefines[i] + "\n";
+    }
+    return defines;
+}
+
+std::string shaderFeatureNames(uint32_t features) {
+    std::string names;
+    for (int i = 0; i < ShaderFeatureCount; ++i) {
+        if (features & (1u << i))
+            names += (names.empty() ? "" : "|") + std::string(FeatureDefines[i]);
+    }
+    return names.empty() ? "none" : names;
+}
+
+void ShaderPermutations::init(const char* programName, const char* vertex, const char* fragment, CompileFunction compileFunction, SetupFunction setupFunction) {
+    name = programName;
+    vertexSource = vertex;
+    fragmentSource = fragment;
+    compile = compileFunction;
+    setup = setupFunction;
+    variants.clear();
+}
+
+void ShaderPermutations::destroy() {
+    for (auto& [features, program] : variants)
+        program->destroy();
+    variants.clear();
+}
+
+ShaderProgram& ShaderPermutations::get(uint32_t features) {
+    auto found = variants.find(features);
+    if (found != variants.end())
+        return *found->second;
+
+    auto program = std::make_unique<ShaderProgram>();
+    program->create(compile(vertexSource, fragmentSource, shaderFeatureDefines(features)));
+    if (setup)
+        setup(*program, features);
+    std::cout << "Built " << name << " shader variant " << shaderFeatureNames(features) << std::endl;
+    return *variants.emplace(features, std::move(program)).first->second;
+}
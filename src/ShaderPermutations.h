@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "ShaderProgram.h"
+
+// --- Shader permutations ---
+// One pair of shader sources written with #ifdef blocks per feature, compiled into a separate
+// program for every combination of features that is actually drawn. Variants are compiled the
+// first time they are asked for and kept by feature mask, so a draw can pick the cheapest program
+// that covers what its material needs.
+
+enum ShaderFeature : uint32_t {
+    ShaderFeatureTextured = 1 << 0,    // TEXTURED: sample a texture with per-vertex coordinates
+    ShaderFeatureVertexColor = 1 << 1, // VERTEX_COLOR: per-vertex color instead of white
+    ShaderFeatureInstanced = 1 << 2,   // INSTANCED: per-instance model matrix, tint and texture array layer
+    ShaderFeatureProcedural = 1 << 3,  // PROCEDURAL: cube vertices derived from gl_VertexID, no vertex buffer
+    ShaderFeatureFeedback = 1 << 4     // FEEDBACK: with INSTANCED and PROCEDURAL, instances captured per vertex by GPU culling
+};
+const int ShaderFeatureCount = 5;
+
+// The #define lines of every feature in mask
+std::string shaderFeatureDefines(uint32_t features);
+// "TEXTURED|VERTEX_COLOR", for logs
+std::string shaderFeatureNames(uint32_t features);
+
+class ShaderPermutations {
+public:
+    // Builds a linked program from sources and defines, e.g. createShaderProgram()
+    using CompileFunction = GLuint (*)(const char* vertexSource, const char* fragmentSource, const std::string& defines);
+    // Called once on every new variant, to bind uniform blocks, set fixed uniforms and resolve the
+    // handles of the uniforms set per draw
+    using SetupFunction = void (*)(ShaderProgram& program, uint32_t features);
+
+    void init(const char* name, const char* vertexSource, const char* fragmentSource, CompileFunction compile, SetupFunction setup = nullptr);
+    void destroy();
+
+    // The variant for features, compiled on first use
+    ShaderProgram& get(uint32_t features);
+
+    size_t variantCount() const { return variants.size(); }
+
+private:
+    const char* name = "";
+    const char* vertexSource = nullptr;
+    const char* fragmentSource = nullptr;
+    CompileFunction compile = nullptr;
+    SetupFunction setup = nullptr;
+    std::unordered_map<uint32_t, std::unique_ptr<ShaderProgram>> variants;
+};
@@ -0,0 +1,114 @@
+#include "ShaderProgram.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "GlState.h"
+
+UniformStats ShaderProgram::stats;
+
+namespace {
+    bool isSamplerType(GLenum type) {
+        switch (type) {
+        case GL_SAMPLER_1D: case GL_SAMPLER_2D: case GL_SAMPLER_3D: case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW: case GL_SAMPLER_2D_ARRAY: case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D: case GL_INT_SAMPLER_BUFFER:
+        case GL_UNSIGNED_INT_SAMPLER_2D: case GL_UNSIGNED_INT_SAMPLER_BUFFER:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    std::string baseName(const char* name) {
+        std::string result = name;
+        size_t bracket = result.find('[');
+        if (bracket != std::string::npos)
+            result.resize(bracket);
+        return result;
+    }
+}
+
+void ShaderProgram::create(GLuint linkedProgram) {
+    program = linkedProgram;
+    uniformSlots.clear();
+    attributeSlots.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(std::max(maxLength, 1));
+    uniformSlots.reserve(count);
+    for (GLint i = 0; i < count; ++i) {
+        UniformSlot slot;
+        glGetActiveUniform(program, (GLuint)i, (GLsizei)name.size(), NULL, &slot.size, &slot.type, name.data());
+        slot.location = glGetUniformLocation(program, name.data());
+        if (slot.location < 0)
+            continue; // Block members are set through their uniform buffer
+        slot.name = baseName(name.data());
+        uniformSlots.push_back(slot);
+    }
+
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    name.assign(std::max(maxLength, 1), '\0');
+    for (GLint i = 0; i < count; ++i) {
+        AttributeSlot slot;
+        GLint size;
+        glGetActiveAttrib(program, (GLuint)i, (GLsizei)name.size(), NULL, &size, &slot.type, name.data());
+        slot.location = glGetAttribLocation(program, name.data());
+        slot.name = name.data();
+        attributeSlots.push_back(slot);
+    }
+}
+
+void ShaderProgram::destroy() {
+    glState.deleteProgram(program);
+    program = 0;
+    uniformSlots.clear();
+    attributeSlots.clear();
+}
+
+UniformSlot* ShaderProgram::findUniform(const char* name, GLenum expectedType, bool isSampler) {
+    for (UniformSlot& slot : uniformSlots) {
+        if (slot.name != name)
+            continue;
+        if (slot.type == expectedType || (isSampler && isSamplerType(slot.type)))
+            return &slot;
+        std::cerr << "Uniform " << name << " of program " << program << " has GL type 0x" << std::hex << slot.type
+                  << ", not 0x" << expectedType << std::dec << std::endl;
+        return nullptr;
+    }
+    std::cerr << "Program " << program << " has no active uniform " << name << std::endl;
+    return nullptr;
+}
+
+bool ShaderProgram::hasUniform(const char* name) const {
+    for (const UniformSlot& slot : uniformSlots) {
+        if (slot.name == name)
+            return true;
+    }
+    return false;
+}
+
+GLint ShaderProgram::attributeLocation(const char* name) const {
+    for (const AttributeSlot& slot : attributeSlots) {
+        if (slot.name == name)
+            return slot.location;
+    }
+    return -1;
+}
+
+bool ShaderProgram::bindUniformBlock(const char* name, GLuint binding) const {
+    GLuint index = glGetUniformBlockIndex(program, name);
+    if (index == GL_INVALID_INDEX)
+        return false;
+    glUniformBlockBinding(program, index, binding);
+    return true;
+}
+
+UniformStats ShaderProgram::resetStats() {
+    UniformStats result = stats;
+    stats = UniformStats();
+    return result;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "GlState.h"
+
+// --- Shader program reflection ---
+// Wraps a linked program and enumerates its active uniforms and attributes once, right after
+// linking. Uniforms are then set through typed handles resolved up front, so the render loop never
+// looks a name up in the driver. Every handle remembers the last value it uploaded and skips
+// glUniform* calls that wouldn't change anything.
+
+struct UniformSlot {
+    std::string name;            // Arrays are listed by their base name, without "[0]"
+    GLint location = -1;
+    GLenum type = GL_NONE;       // GL_FLOAT_MAT4, GL_SAMPLER_2D, ...
+    GLint size = 1;              // Array length
+    float value[16] = {};        // Last uploaded value, for the redundancy check
+    bool valueKnown = false;
+};
+
+struct AttributeSlot {
+    std::string name;
+    GLint location = -1;
+    GLenum type = GL_NONE;
+};
+
+// Upload counters, shared by every program
+struct UniformStats {
+    int uploads = 0;
+    int skipped = 0;             // Sets that matched the value already in the program
+};
+
+// Typed handle to one uniform. A default-constructed or unresolved handle ignores sets.
+// The program the uniform belongs to must be in use when set() is called.
+template <typename T>
+class Uniform {
+public:
+    Uniform() = default;
+    explicit Uniform(UniformSlot* slot) : slot(slot) {}
+
+    bool valid() const { return slot != nullptr; }
+    void set(const T& value) const;
+
+private:
+    UniformSlot* slot = nullptr;
+};
+
+class ShaderProgram {
+public:
+    ShaderProgram() = default;
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+    // Take ownership of a linked program and reflect its uniforms and attributes
+    void create(GLuint program);
+    void destroy();
+
+    GLuint id() const { return program; }
+    void use() const { glState.useProgram(program); }
+
+    // Resolve a uniform of type T. Returns an invalid handle, and reports it, when the program
+    // has no active uniform of that name and type (the compiler drops unused uniforms).
+    template <typename T>
+    Uniform<T> uniform(const char* name);
+
+    bool hasUniform(const char* name) const;
+
+    // Location of an active vertex attribute, or -1
+    GLint attributeLocation(const char* name) const;
+
+    // Point a uniform block at a buffer binding. Returns false if the program doesn't use the block.
+    bool bindUniformBlock(const char* name, GLuint binding) const;
+
+    const std::vector<UniformSlot>& uniforms() const { return uniformSlots; }
+    const std::vector<AttributeSlot>& attributes() const { return attributeSlots; }
+
+    // Return the counters gathered since the previous call and start counting again
+    static UniformStats resetStats();
+    static UniformStats stats;
+
+private:
+    UniformSlot* findUniform(const char* name, GLenum expectedType, bool isSampler);
+
+    GLuint program = 0;
+    std::vector<UniformSlot> uniformSlots; // Never resized after create(), handles point into it
+    std::vector<AttributeSlot> attributeSlots;
+};
+
+namespace UniformUpload {
+    inline void upload(GLint location, const int& value) { glUniform1i(location, value); }
+    inline void upload(GLint location, const float& value) { glUniform1f(location, value); }
+    inline void upload(GLint location, const glm::vec2& value) { glUniform2fv(location, 1, glm::value_ptr(value)); }
+    inline void upload(GLint location, const glm::vec3& value) { glUniform3fv(location, 1, glm::value_ptr(value)); }
+    inline void upload(GLint location, const glm::vec4& value) { glUniform4fv(location, 1, glm::value_ptr(value)); }
+    inline void upload(GLint location, const glm::mat4& value) { glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value)); }
+
+    // The GL type a uniform needs to be set with T. Integer handles also drive samplers.
+    template <typename T> GLenum glType();
+    template <> inline GLenum glType<int>() { return GL_INT; }
+    template <> inline GLenum glType<float>() { return GL_FLOAT; }
+    template <> inline GLenum glType<glm::vec2>() { return GL_FLOAT_VEC2; }
+    template <> inline GLenum glType<glm::vec3>() { return GL_FLOAT_VEC3; }
+    template <> inline GLenum glType<glm::vec4>() { return GL_FLOAT_VEC4; }
+    template <> inline GLenum glType<glm::mat4>() { return GL_FLOAT_MAT4; }
+}
+
+template <typename T>
+void Uniform<T>::set(const T& value) const {
+    static_assert(sizeof(T) <= sizeof(UniformSlot::value), "Uniform value too large for the shadow copy");
+    if (!slot)
+        return;
+    if (slot->valueKnown && std::memcmp(slot->value, &value, sizeof(T)) == 0) {
+        ShaderProgram::stats.skipped++;
+        return;
+    }
+    UniformUpload::upload(slot->location, value);
+    std::memcpy(slot->value, &value, sizeof(T));
+    slot->valueKnown = true;
+    ShaderProgram::stats.uploads++;
+}
+
+template <typename T>
+Uniform<T> ShaderProgram::uniform(const char* name) {
+    return Uniform<T>(findUniform(name, UniformUpload::glType<T>(), std::is_same<T, int>::value));
+}
@@ -0,0 +1,260 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GlyphCache.h"
+#include "GlState.h"
+
+// --- Text layout cache ---
+// Keeps the laid-out glyph records of every label from one frame to the next in a single
+// persistent vertex buffer. A label is identified by where and how it is drawn (TextLayoutKey);
+// its text is compared on every submit:
+//  - unchanged text reuses the records already on the GPU, and only re-touches the cached glyphs,
+//  - changed text re-lays out only the glyphs from the first differing character on,
+//  - labels not submitted during a frame release their range at the next flush.
+// Every label has its own range in the buffer, and unused records are zeroed so they draw as
+// degenerate quads. The whole buffer is therefore drawn with one call.
+
+struct TextLayoutKey {
+    GlyphCache* cache;       // Font and raster mode
+    float x, y;
+    float scale;
+    uint32_t color;          // Packed RGBA8
+
+    bool operator==(const TextLayoutKey& other) const {
+        return cache == other.cache && x == other.x && y == other.y && scale == other.scale && color == other.color;
+    }
+};
+
+struct TextLayoutKeyHash {
+    size_t operator()(const TextLayoutKey& key) const {
+        uint32_t bits[4];
+        std::memcpy(&bits[0], &key.x, sizeof(float));
+        std::memcpy(&bits[1], &key.y, sizeof(float));
+        std::memcpy(&bits[2], &key.scale, sizeof(float));
+        bits[3] = key.color;
+        size_t hash = std::hash<const void*>()(key.cache);
+        for (uint32_t b : bits)
+            hash ^= std::hash<uint32_t>()(b) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+};
+
+// One laid-out glyph, with what is needed to resume layout after it
+template <typename Record>
+struct LaidOutGlyph {
+    Record record;
+    uint32_t byteOffset;      // Start of the glyph's UTF-8 sequence in the label text
+    float penX;               // Pen position the glyph was laid out at
+    const CachedGlyph* glyph;
+};
+
+struct TextLayoutStats {
+    int hits = 0;             // Labels reused without any layout
+    int partialHits = 0;      // Labels that kept a prefix of their glyphs
+    int misses = 0;           // Labels laid out from scratch
+    int glyphsLaidOut = 0;
+    int glyphsDrawn = 0;
+    int uploads = 0;
+    size_t bytesUploaded = 0;
+};
+
+template <typename Record>
+class TextLayoutCache {
+public:
+    using Glyph = LaidOutGlyph<Record>;
+
+    // layout(text, startByte, penX, glyphs) appends the glyphs of text[startByte..] with the pen
+    // starting at penX, and returns the pen position after the last one.
+    // Returns the label's glyphs, valid until the next submit or flush.
+    template <typename LayoutFunction>
+    const std::vector<Glyph>& submit(const TextLayoutKey& key, const std::string& text, LayoutFunction&& layout);
+
+    // Release labels that weren't submitted this frame, then upload the records that changed.
+    // Returns how many records (used and degenerate) the draw has to cover.
+    size_t flush(GLuint buffer, GLsizeiptr& bufferCapacity);
+
+    void beginFrame() { frame++; }
+
+    // Return the counters gathered since the previous call and start counting again
+    TextLayoutStats resetStats() {
+        TextLayoutStats result = stats;
+        stats = TextLayoutStats();
+        return result;
+    }
+
+private:
+    struct Label {
+        std::string text;
+        std::vector<Glyph> glyphs;
+        float endPenX = 0.0f;
+        size_t first = 0, capacity = 0; // Range of records owned in the buffer
+        uint64_t evictionCount = 0;     // Glyph cache eviction count when the glyph pointers were taken
+        uint64_t lastUsedFrame = 0;
+        bool laidOut = false;
+        bool missingGlyphs = false;     // Some glyphs couldn't be placed in the atlas
+    };
+
+    void release(Label& label);
+    void markDirty(size_t begin, size_t end) {
+        dirtyBegin = std::min(dirtyBegin, begin);
+        dirtyEnd = std::max(dirtyEnd, end);
+    }
+    void compact();
+
+    std::unordered_map<TextLayoutKey, Label, TextLayoutKeyHash> labels;
+    std::vector<Record> records; // CPU copy of the buffer
+    size_t liveRecords = 0;      // Records owned by labels, the rest are holes
+    size_t dirtyBegin = SIZE_MAX, dirtyEnd = 0;
+    uint64_t frame = 1;
+    TextLayoutStats stats;
+};
+
+template <typename Record>
+template <typename LayoutFunction>
+const std::vector<LaidOutGlyph<Record>>& TextLayoutCache<Record>::submit(const TextLayoutKey& key, const std::string& text, LayoutFunction&& layout) {
+    GlyphCache& cache = *key.cache;
+    Label& label = labels[key];
+    label.lastUsedFrame = frame;
+
+    bool glyphsValid = label.laidOut && !label.missingGlyphs && label.evictionCount == cache.evictionCount();
+    if (glyphsValid && label.text == text) {
+        for (const Glyph& g : label.glyphs)
+            cache.touch(g.glyph);
+        stats.hits++;
+        stats.glyphsDrawn += (int)label.glyphs.size();
+        return label.glyphs;
+    }
+
+    // Keep every glyph whose UTF-8 sequence lies entirely inside the unchanged prefix
+    size_t oldCount = label.glyphs.size();
+    size_t keep = 0;
+    if (glyphsValid) {
+        size_t common = std::mismatch(label.text.begin(), label.text.end(), text.begin(), text.end()).first - label.text.begin();
+        auto glyphEnd = [&](size_t k) { return k + 1 < oldCount ? label.glyphs[k + 1].byteOffset : label.text.size(); };
+        while (keep < oldCount && glyphEnd(keep) <= common)
+            keep++;
+        // A malformed sequence can decode differently once the bytes after it change.
+        // UTF-8 decoding looks at most 4 bytes ahead, so only glyphs that close to the edit need checking.
+        for (size_t k = keep; k-- > 0 && label.glyphs[k].byteOffset + 4 > common;) {
+            size_t position = label.glyphs[k].byteOffset;
+            if (nextCodepoint(text, position) != label.glyphs[k].glyph->codepoint || position != glyphEnd(k))
+                keep = k;
+        }
+    }
+    if (keep > 0)
+        stats.partialHits++;
+    else
+        stats.misses++;
+    for (size_t k = 0; k < keep; ++k)
+        cache.touch(label.glyphs[k].glyph); // Pin them before layout can evict anything
+
+    size_t resumeByte = keep < oldCount ? label.glyphs[keep].byteOffset : label.text.size();
+    float resumePen = keep < oldCount ? label.glyphs[keep].penX : label.endPenX;
+    if (keep == 0) {
+        resumeByte = 0;
+        resumePen = key.x;
+    }
+    label.glyphs.resize(keep);
+    uint64_t failuresBefore = cache.failureCount();
+    label.endPenX = layout(text, resumeByte, resumePen, label.glyphs);
+    label.text = text;
+    label.evictionCount = cache.evictionCount();
+    label.laidOut = true;
+    // Retry next frame, when glyphs pinned by this frame can be evicted to make room
+    label.missingGlyphs = cache.failureCount() != failuresBefore;
+
+    size_t newCount = label.glyphs.size();
+    stats.glyphsLaidOut += (int)(newCount - keep);
+    stats.glyphsDrawn += (int)newCount;
+
+    if (newCount > label.capacity) {
+        // Move the label to the end of the buffer with some room to grow
+        release(label);
+        label.first = records.size();
+        label.capacity = std::max<size_t>(newCount + newCount / 2, 8);
+        records.resize(label.first + label.capacity);
+        liveRecords += label.capacity;
+        for (size_t k = 0; k < newCount; ++k)
+            records[label.first + k] = label.glyphs[k].record;
+        markDirty(label.first, label.first + label.capacity);
+        return label.glyphs;
+    }
+    for (size_t k = keep; k < newCount; ++k)
+        records[label.first + k] = label.glyphs[k].record;
+    for (size_t k = newCount; k < oldCount; ++k)
+        records[label.first + k] = Record();
+    markDirty(label.first + keep, label.first + std::max(newCount, oldCount));
+    return label.glyphs;
+}
+
+template <typename Record>
+void TextLayoutCache<Record>::release(Label& label) {
+    if (label.capacity == 0)
+        return;
+    std::fill(records.begin() + label.first, records.begin() + label.first + label.capacity, Record());
+    markDirty(label.first, label.first + label.capacity);
+    liveRecords -= label.capacity;
+    label.capacity = 0;
+}
+
+template <typename Record>
+void TextLayoutCache<Record>::compact() {
+    std::vector<Record> packed;
+    packed.reserve(liveRecords);
+    for (auto& [key, label] : labels) {
+        size_t first = packed.size();
+        packed.insert(packed.end(), records.begin() + label.first, records.begin() + label.first + label.capacity);
+        label.first = first;
+    }
+    records.swap(packed);
+    dirtyBegin = 0;
+    dirtyEnd = records.size();
+}
+
+template <typename Record>
+size_t TextLayoutCache<Record>::flush(GLuint buffer, GLsizeiptr& bufferCapacity) {
+    for (auto it = labels.begin(); it != labels.end();) {
+        if (it->second.lastUsedFrame != frame) {
+            release(it->second);
+            it = labels.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Squeeze the buffer once holes outweigh the labels
+    if (liveRecords == 0) {
+        records.clear();
+    } else if (records.size() > 2 * liveRecords + 256) {
+        compact();
+    }
+
+    glState.bindBuffer(GL_ARRAY_BUFFER, buffer);
+    GLsizeiptr bytes = (GLsizeiptr)(records.size() * sizeof(Record));
+    if (bytes > bufferCapacity) {
+        bufferCapacity = std::max(bytes, bufferCapacity * 2);
+        glBufferData(GL_ARRAY_BUFFER, bufferCapacity, NULL, GL_DYNAMIC_DRAW);
+        dirtyBegin = 0;
+        dirtyEnd = records.size();
+    }
+    dirtyEnd = std::min(dirtyEnd, records.size());
+    if (dirtyBegin < dirtyEnd) {
+        GLsizeiptr dirtyBytes = (GLsizeiptr)((dirtyEnd - dirtyBegin) * sizeof(Record));
+        glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)(dirtyBegin * sizeof(Record)), dirtyBytes, &records[dirtyBegin]);
+        stats.uploads++;
+        stats.bytesUploaded += dirtyBytes;
+    }
+    dirtyBegin = SIZE_MAX;
+    dirtyEnd = 0;
+
+    return records.size();
+}
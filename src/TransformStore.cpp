@@ -0,0 +1,140 @@
+#include "TransformStore.h"
+
+#include <algorithm>
+#include <cstring>
+
+TransformId TransformStore::create(TransformId parent) {
+    TransformId id = (TransformId)parents.size();
+    for (std::vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ })
+        component->push_back(0.0f);
+    for (std::vector<float>* component : { &rotationW, &scaleX, &scaleY, &scaleZ })
+        component->push_back(1.0f);
+    parents.push_back(parent < id ? parent : NoTransform);
+    dirty.push_back(0);
+    worlds.push_back(glm::mat4(1.0f));
+    markDirty(id);
+    return id;
+}
+
+void TransformStore::reserve(size_t count) {
+    for (std::vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ,
+                                           &rotationW, &scaleX, &scaleY, &scaleZ })
+        component->reserve(count);
+    parents.reserve(count);
+    dirty.reserve(count);
+    worlds.reserve(count);
+}
+
+void TransformStore::clear() {
+    for (std::vector<float>* component : { &positionX, &positionY, &positionZ, &rotationX, &rotationY, &rotationZ,
+                                           &rotationW, &scaleX, &scaleY, &scaleZ })
+        component->clear();
+    parents.clear();
+    dirty.clear();
+    worlds.clear();
+    firstDirty = SIZE_MAX;
+    updatedFirst = updatedCount = 0;
+}
+
+void TransformStore::markDirty(TransformId id) {
+    dirty[id] = 1;
+    firstDirty = std::min(firstDirty, (size_t)id);
+}
+
+void TransformStore::setPosition(TransformId id, const glm::vec3& position) {
+    positionX[id] = position.x;
+    positionY[id] = position.y;
+    positionZ[id] = position.z;
+    markDirty(id);
+}
+
+void TransformStore::setRotation(TransformId id, const glm::quat& rotation) {
+    rotationX[id] = rotation.x;
+    rotationY[id] = rotation.y;
+    rotationZ[id] = rotation.z;
+    rotationW[id] = rotation.w;
+    markDirty(id);
+}
+
+void TransformStore::setScale(TransformId id, const glm::vec3& scale) {
+    scaleX[id] = scale.x;
+    scaleY[id] = scale.y;
+    scaleZ[id] = scale.z;
+    markDirty(id);
+}
+
+void TransformStore::set(TransformId id, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+    setPosition(id, position);
+    setRotation(id, rotation);
+    setScale(id, scale);
+}
+
+void TransformStore::setParent(TransformId id, TransformId parent) {
+    parents[id] = parent < id ? parent : NoTransform;
+    markDirty(id);
+}
+
+TransformArrays TransformStore::arrays(size_t first, size_t count) const {
+    return { positionX.data() + first, positionY.data() + first, positionZ.data() + first,
+             rotationX.data() + first, rotationY.data() + first, rotationZ.data() + first, rotationW.data() + first,
+             scaleX.data() + first, scaleY.data() + first, scaleZ.data() + first, count };
+}
+
+namespace {
+    // Compose the local matrices of the dirty transforms in [first, end), a run of them at a time
+    void composeDirty(const TransformStore& store, const uint8_t* dirty, size_t first, size_t end, glm::mat4* worlds, MatrixKernel kernel) {
+        for (size_t i = first; i < end;) {
+            if (!dirty[i]) {
+                ++i;
+                continue;
+            }
+            size_t runEnd = i + 1;
+            while (runEnd < end && dirty[runEnd])
+                ++runEnd;
+            composeTransforms(store.arrays(i, runEnd - i), worlds + i, kernel);
+            i = runEnd;
+        }
+    }
+}
+
+size_t TransformStore::update(JobSystem* jobs) {
+    updatedFirst = updatedCount = 0;
+    const size_t count = parents.size();
+    if (firstDirty >= count)
+        return 0;
+
+    // Parents come before their children, so by the time a transform is reached its parent's flag
+    // already includes every dirty ancestor
+    size_t updated = 0, last = firstDirty;
+    for (size_t i = firstDirty; i < count; ++i) {
+        TransformId parent = parents[i];
+        if (parent != NoTransform && parent >= firstDirty)
+            dirty[i] |= dirty[parent];
+        if (dirty[i]) {
+            updated++;
+            last = i;
+        }
+    }
+
+    // Local matrices of each run of dirty transforms, straight into the world matrix array
+    const size_t end = last + 1;
+    if (jobs && end - firstDirty >= ParallelUpdateThreshold) {
+        jobs->wait(jobs->parallelFor(end - firstDirty, ParallelUpdateThreshold / 2, [&](size_t begin, size_t batchEnd) {
+            composeDirty(*this, dirty.data(), firstDirty + begin, firstDirty + batchEnd, worlds.data(), matrixKernel);
+        }));
+    } else {
+        composeDirty(*this, dirty.data(), firstDirty, end, worlds.data(), matrixKernel);
+    }
+
+    // Then in order, so each parent's world matrix is final before its children use it
+    for (size_t i = firstDirty; i < end; ++i) {
+        TransformId parent = parents[i];
+        if (dirty[i] && parent != NoTransform)
+            worlds[i] = worlds[parent] * worlds[i];
+    }
+    std::memset(dirty.data() + firstDirty, 0, count - firstDirty);
+    updatedFirst = firstDirty;
+    updatedCount = end - firstDirty;
+    firstDirty = SIZE_MAX;
+    return updated;
+}
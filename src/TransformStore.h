@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "JobSystem.h"
+#include "MatrixBatch.h"
+
+// --- Transform store ---
+// Position, rotation and scale of every object in the scene, kept as one array per component
+// (structure of arrays) so a pass over many transforms streams through memory and can be
+// vectorized. Transforms form a hierarchy: each one may have a parent created before it, so one
+// pass in creation order always reaches parents before their children. Setting a transform marks
+// it dirty, and update() rebuilds the world matrices of dirty transforms and of everything below
+// them, starting at the first dirty one; untouched transforms and subtrees cost a flag test. Runs
+// of dirty transforms are composed in SIMD batches (see MatrixBatch.h), on several threads when
+// there are many. The world matrices sit side by side in creation order, ready to be copied into
+// an instance buffer.
+
+typedef uint32_t TransformId;
+const TransformId NoTransform = UINT32_MAX;
+
+class TransformStore {
+public:
+    // Updates spanning at least this many transforms compose them in parallel, when given a job system
+    static const size_t ParallelUpdateThreshold = 8 * 1024;
+
+    // Add an identity transform below parent, which must already exist
+    TransformId create(TransformId parent = NoTransform);
+    void reserve(size_t count);
+    void clear();
+
+    void setPosition(TransformId id, const glm::vec3& position);
+    void setRotation(TransformId id, const glm::quat& rotation);
+    void setScale(TransformId id, const glm::vec3& scale);
+    void set(TransformId id, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+
+    glm::vec3 position(TransformId id) const { return glm::vec3(positionX[id], positionY[id], positionZ[id]); }
+    glm::quat rotation(TransformId id) const { return glm::quat(rotationW[id], rotationX[id], rotationY[id], rotationZ[id]); }
+    glm::vec3 scale(TransformId id) const { return glm::vec3(scaleX[id], scaleY[id], scaleZ[id]); }
+    TransformId parent(TransformId id) const { return parents[id]; }
+    // Move id and everything below it under parent, which must have been created before id.
+    // NoTransform, or any later transform, makes id a root.
+    void setParent(TransformId id, TransformId parent);
+
+    // Rebuild the world matrices that changed since the last update and return how many that was.
+    // Composing is spread over jobs' threads if given; applying parents stays on this one.
+    size_t update(JobSystem* jobs = nullptr);
+    // The transforms update() last rebuilt lie in [first, first + count), for partial uploads
+    void updatedRange(size_t& first, size_t& count) const { first = updatedFirst; count = updatedCount; }
+
+    // The components of count transforms from first on, for composeTransforms()
+    TransformArrays arrays(size_t first, size_t count) const;
+    // Kernel update() composes with, the best the CPU has by default
+    void setMatrixKernel(MatrixKernel kernel) { matrixKernel = supportedMatrixKernel(kernel); }
+
+    const glm::mat4& world(TransformId id) const { return worlds[id]; }
+    const glm::mat4* worldMatrices() const { return worlds.data(); }
+    size_t size() const { return parents.size(); }
+
+private:
+    void markDirty(TransformId id);
+
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+    std::vector<float> scaleX, scaleY, scaleZ;
+    std::vector<TransformId> parents;
+    std::vector<uint8_t> dirty; // Set by the setters, and by update() for the children of dirty transforms
+    std::vector<glm::mat4> worlds;
+    size_t firstDirty = SIZE_MAX;
+    MatrixKernel matrixKernel = bestMatrixKernel();
+    size_t updatedFirst = 0, updatedCount = 0;
+};
@@ -0,0 +1,89 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "GlState.h"
+
+namespace {
+    size_t alignUp(size_t value, size_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+bool UniformRing::init(size_t segmentBytes) {
+    GLint offsetAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+    alignment = std::max<size_t>(offsetAlignment, 16);
+    segmentSize = alignUp(segmentBytes, alignment);
+    segment = Segments - 1; // beginFrame() moves on to segment 0
+
+    glGenBuffers(1, &buffer);
+    glState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, segmentSize * Segments, NULL, GL_DYNAMIC_DRAW);
+    glState.bindBuffer(GL_UNIFORM_BUFFER, 0);
+    staging.reserve(segmentSize);
+    return buffer != 0;
+}
+
+void UniformRing::destroy() {
+    for (GLsync& fence : fences) {
+        if (fence) glDeleteSync(fence);
+        fence = nullptr;
+    }
+    glState.deleteBuffers(1, &buffer);
+    buffer = 0;
+}
+
+void UniformRing::beginFrame() {
+    segment = (segment + 1) % Segments;
+    GLsync& fence = fences[segment];
+    if (fence) {
+        // Normally signalled long ago, Segments - 1 frames have been submitted since
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {}
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+    staging.clear();
+}
+
+size_t UniformRing::push(const void* data, size_t size) {
+    size_t offset = alignUp(staging.size(), alignment);
+    staging.resize(offset + size);
+    std::memcpy(&staging[offset], data, size);
+    return offset;
+}
+
+void UniformRing::upload() {
+    lastUploadBytes = staging.size();
+    if (staging.empty())
+        return;
+    glState.bindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (staging.size() > segmentSize) {
+        // Grow every segment. The old store is orphaned, so pending draws keep reading it.
+        for (GLsync& fence : fences) {
+            if (fence) glDeleteSync(fence);
+            fence = nullptr;
+        }
+        segmentSize = alignUp(std::max(staging.size(), segmentSize * 2), alignment);
+        glBufferData(GL_UNIFORM_BUFFER, segmentSize * Segments, NULL, GL_DYNAMIC_DRAW);
+    }
+    // The fence waited on in beginFrame() already guarantees the GPU is done with this segment
+    void* target = glMapBufferRange(GL_UNIFORM_BUFFER, segment * segmentSize, staging.size(),
+                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+    if (target) {
+        std::memcpy(target, staging.data(), staging.size());
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    } else {
+        std::cerr << "Failed to map the uniform buffer ring" << std::endl;
+    }
+}
+
+void UniformRing::bind(GLuint binding, size_t offset, size_t size) const {
+    glState.bindBufferRange(GL_UNIFORM_BUFFER, binding, buffer, (GLintptr)(segment * segmentSize + offset), (GLsizeiptr)size);
+}
+
+void UniformRing::endFrame() {
+    fences[segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+
+// --- Uniform buffer ring ---
+// One uniform buffer split into a few per-frame segments. Every frame, the uniform blocks the frame
+// needs (shared per-frame data and one block per object) are gathered on the CPU, copied into the
+// next segment with a single upload, and bound to their block bindings with glBindBufferRange.
+// A fence per segment keeps the CPU from overwriting data the GPU hasn't read yet.
+
+class UniformRing {
+public:
+    static const int Segments = 3;
+
+    bool init(size_t segmentBytes);
+    void destroy();
+
+    // Start gathering this frame's blocks. Waits if the GPU still reads the segment about to be reused.
+    void beginFrame();
+
+    // Append a block and return its offset in the frame. Offsets honour GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT.
+    size_t push(const void* data, size_t size);
+    template <typename Block>
+    size_t push(const Block& block) { return push(&block, sizeof(Block)); }
+
+    // Copy every block pushed this frame to the GPU. Call once, after the last push and before drawing.
+    void upload();
+
+    // Bind a block pushed this frame to a uniform block binding point
+    void bind(GLuint binding, size_t offset, size_t size) const;
+    template <typename Block>
+    void bind(GLuint binding, size_t offset) const { bind(binding, offset, sizeof(Block)); }
+
+    // Fence the segment once the frame's draws have been submitted
+    void endFrame();
+
+    size_t bytesUploaded() const { return lastUploadBytes; }
+
+private:
+    GLuint buffer = 0;
+    size_t segmentSize = 0;
+    size_t alignment = 256;
+    int segment = 0;
+    GLsync fences[Segments] = {};
+    std::vector<unsigned char> staging;
+    size_t lastUploadBytes = 0;
+};
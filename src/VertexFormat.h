@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glad/glad.h>
+
+// --- Vertex formats ---
+// A vertex struct and the attributes it feeds are described once, and the description issues the
+// glVertexAttribPointer calls. The GL component type and count come from the struct members, so
+// packing a member into a smaller type (half floats, normalized bytes and shorts) can't leave a
+// stale GL_FLOAT behind. Also holds the conversions used to fill packed members.
+
+// IEEE 754 binary16, read by GL as GL_HALF_FLOAT
+struct HalfFloat {
+    uint16_t bits;
+};
+
+// Float to half, rounding to nearest. Values too small for a half flush to zero, too large become infinity.
+inline HalfFloat toHalf(float value) {
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    uint16_t sign = (uint16_t)((f >> 16) & 0x8000);
+    int exponent = (int)((f >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = f & 0x7FFFFF;
+    if (exponent <= 0)
+        return { sign };
+    if (exponent >= 31)
+        return { (uint16_t)(sign | 0x7C00) };
+    uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+    half += (mantissa >> 12) & 1; // Round to nearest, a carry into the exponent is still correct
+    return { (uint16_t)(sign | half) };
+}
+
+// Floats in [0, 1] or [-1, 1] to the normalized integers GL maps back to them
+inline uint8_t toUnorm8(float value) { return (uint8_t)std::lround(std::fmin(std::fmax(value, 0.0f), 1.0f) * 255.0f); }
+inline uint16_t toUnorm16(float value) { return (uint16_t)std::lround(std::fmin(std::fmax(value, 0.0f), 1.0f) * 65535.0f); }
+inline int16_t toSnorm16(float value) { return (int16_t)std::lround(std::fmin(std::fmax(value, -1.0f), 1.0f) * 32767.0f); }
+
+// GL type of a vertex component
+template <typename T> struct VertexComponentType;
+template <> struct VertexComponentType<float> { static const GLenum value = GL_FLOAT; };
+template <> struct VertexComponentType<HalfFloat> { static const GLenum value = GL_HALF_FLOAT; };
+template <> struct VertexComponentType<int8_t> { static const GLenum value = GL_BYTE; };
+template <> struct VertexComponentType<uint8_t> { static const GLenum value = GL_UNSIGNED_BYTE; };
+template <> struct VertexComponentType<int16_t> { static const GLenum value = GL_SHORT; };
+template <> struct VertexComponentType<uint16_t> { static const GLenum value = GL_UNSIGNED_SHORT; };
+template <> struct VertexComponentType<int32_t> { static const GLenum value = GL_INT; };
+template <> struct VertexComponentType<uint32_t> { static const GLenum value = GL_UNSIGNED_INT; };
+
+// GL type of an index
+template <typename T> struct IndexType;
+template <> struct IndexType<uint8_t> { static const GLenum value = GL_UNSIGNED_BYTE; };
+template <> struct IndexType<uint16_t> { static const GLenum value = GL_UNSIGNED_SHORT; };
+template <> struct IndexType<uint32_t> { static const GLenum value = GL_UNSIGNED_INT; };
+
+// How the shader sees an attribute's components
+enum class VertexAttributeMode {
+    Float,      // Converted to float as is (float and half members, or integers read as 0, 1, 2, ...)
+    Normalized, // Integers mapped to [0, 1] (unsigned) or [-1, 1] (signed)
+    Integer     // Kept as integers, for int/uint/ivecN/uvecN shader inputs
+};
+
+struct VertexAttribute {
+    GLuint location;
+    GLint size;          // Components the shader reads, may be fewer than the member holds
+    GLenum type;
+    VertexAttributeMode mode;
+    size_t offset;
+};
+
+template <typename Vertex>
+class VertexFormat {
+public:
+    // Add an array member, e.g. attribute(0, &Vertex::position). size defaults to the array length;
+    // a smaller size leaves trailing components as padding.
+    template <typename Component, size_t Count>
+    VertexFormat& attribute(GLuint location, Component (Vertex::*member)[Count],
+                            VertexAttributeMode mode = VertexAttributeMode::Float, GLint size = (GLint)Count) {
+        static_assert(Count >= 1 && Count <= 4, "A vertex attribute has one to four components");
+        const Vertex probe{};
+        size_t offset = (size_t)((const char*)&(probe.*member) - (const char*)&probe);
+        attributeList.push_back({ location, size, VertexComponentType<Component>::value, mode, offset });
+        return *this;
+    }
+
+    // Add a scalar member
+    template <typename Component>
+    VertexFormat& attribute(GLuint location, Component Vertex::*member, VertexAttributeMode mode = VertexAttributeMode::Float) {
+        const Vertex probe{};
+        size_t offset = (size_t)((const char*)&(probe.*member) - (const char*)&probe);
+        attributeList.push_back({ location, 1, VertexComponentType<Component>::value, mode, offset });
+        return *this;
+    }
+
+    // Point the bound VAO's attributes at the buffer bound to GL_ARRAY_BUFFER.
+    // A divisor of 1 steps the attributes once per instance.
+    void apply(GLuint divisor = 0) const {
+        for (const VertexAttribute& a : attributeList) {
+            glEnableVertexAttribArray(a.location);
+            if (a.mode == VertexAttributeMode::Integer)
+                glVertexAttribIPointer(a.location, a.size, a.type, sizeof(Vertex), (void*)a.offset);
+            else
+                glVertexAttribPointer(a.location, a.size, a.type, a.mode == VertexAttributeMode::Normalized ? GL_TRUE : GL_FALSE,
+                                      sizeof(Vertex), (void*)a.offset);
+            if (divisor != 0)
+                glVertexAttribDivisor(a.location, divisor);
+        }
+    }
+
+    const std::vector<VertexAttribute>& attributes() const { return attributeList; }
+
+private:
+    std::vector<VertexAttribute> attributeList;
+};
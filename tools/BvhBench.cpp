@@ -0,0 +1,190 @@
+// --- BVH benchmark ---
+// Times building, refitting and querying the BVH (see src/Bvh.h) over a field of boxes laid out like
+// Cubey's cube field, and compares culling with the linear FrustumCuller and ray queries with a
+// linear scan, checking that both give the same answers.
+//
+// Usage: BvhBench [--boxes <count>] [--threads <count>] [--views <count>] [--rays <count>]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Bvh.h"
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+namespace {
+    struct Options {
+        size_t boxes = 1000000;
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        int views = 64;
+        int rays = 200000;
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // A jittered grid with spacing 2 and boxes of rotated cubes' sizes, as CubeField scatters them
+    std::vector<BvhBox> makeBoxes(size_t count, std::mt19937& gen, float& radius) {
+        size_t side = std::max<size_t>(1, (size_t)std::ceil(std::cbrt((double)count)));
+        while (side * side * side < count) ++side;
+        float center = (side - 1) * 0.5f;
+        std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+        std::uniform_real_distribution<float> halfSize(0.25f, 0.85f);
+        std::vector<BvhBox> boxes(count);
+        for (size_t i = 0; i < count; ++i) {
+            glm::vec3 cell((float)(i % side), (float)(i / side % side), (float)(i / (side * side)));
+            glm::vec3 position = (cell - glm::vec3(center)) * 2.0f + glm::vec3(jitter(gen), jitter(gen), jitter(gen));
+            boxes[i] = bvhBox(position, glm::vec3(halfSize(gen), halfSize(gen), halfSize(gen)));
+        }
+        radius = std::sqrt(3.0f) * (center * 2.0f + 1.0f);
+        return boxes;
+    }
+
+    // The nearest box along the ray by testing every one of them
+    bool raycastLinear(const std::vector<BvhBox>& boxes, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, BvhRayHit& hit) {
+        glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+        bool found = false;
+        for (size_t i = 0; i < boxes.size(); ++i) {
+            float enter = 0.0f, exit = maxDistance;
+            for (int axis = 0; axis < 3; ++axis) {
+                float t0 = (boxes[i].min[axis] - origin[axis]) * inverseDirection[axis];
+                float t1 = (boxes[i].max[axis] - origin[axis]) * inverseDirection[axis];
+                enter = std::max(enter, std::min(t0, t1));
+                exit = std::min(exit, std::max(t0, t1));
+            }
+            if (enter <= exit) {
+                maxDistance = enter;
+                hit.box = (uint32_t)i;
+                hit.distance = enter;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--boxes" && i + 1 < argc) {
+                options.boxes = std::max<size_t>(1, std::strtoull(argv[++i], NULL, 10));
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::max(1ul, std::strtoul(argv[++i], NULL, 10));
+            } else if (arg == "--views" && i + 1 < argc) {
+                options.views = std::max(1, std::atoi(argv[++i]));
+            } else if (arg == "--rays" && i + 1 < argc) {
+                options.rays = std::max(1, std::atoi(argv[++i]));
+            } else {
+                std::cerr << "Usage: BvhBench [--boxes <count>] [--threads <count>] [--views <count>] [--rays <count>]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    std::mt19937 gen(1);
+    float radius;
+    std::vector<BvhBox> boxes = makeBoxes(options.boxes, gen, radius);
+    std::cout << std::format("{} boxes, {} threads", boxes.size(), options.threads) << std::endl;
+
+    // --- Build and refit ---
+    Bvh bvh;
+    auto start = std::chrono::steady_clock::now();
+    bvh.build(boxes);
+    double serialBuild = secondsSince(start);
+    JobSystem jobs;
+    jobs.init((int)options.threads - 1);
+    start = std::chrono::steady_clock::now();
+    bvh.build(boxes, &jobs);
+    double parallelBuild = secondsSince(start);
+    std::cout << std::format("Build: {:.1f} ms on 1 thread, {:.1f} ms on {} ({:.1f}x), {} nodes",
+        serialBuild * 1000.0, parallelBuild * 1000.0, options.threads, serialBuild / parallelBuild, bvh.nodeCount()) << std::endl;
+
+    std::uniform_real_distribution<float> drift(-0.05f, 0.05f);
+    std::vector<BvhBox> moved = boxes;
+    for (BvhBox& box : moved) {
+        glm::vec3 offset(drift(gen), drift(gen), drift(gen));
+        box.min += offset;
+        box.max += offset;
+    }
+    start = std::chrono::steady_clock::now();
+    bvh.refit(moved);
+    double refit = secondsSince(start);
+    std::cout << std::format("Refit: {:.1f} ms", refit * 1000.0) << std::endl;
+    bvh.refit(boxes);
+
+    // --- Culling, against the linear SIMD culler ---
+    FrustumCuller linear;
+    linear.reserve(boxes.size());
+    for (const BvhBox& box : boxes)
+        linear.addBox((box.min + box.max) * 0.5f, (box.max - box.min) * 0.5f);
+    std::vector<uint32_t> visible(boxes.size());
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> distance(0.2f, 1.5f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, radius * 4.0f);
+    double bvhCull = 0.0, linearCull = 0.0;
+    size_t bvhVisible = 0, linearVisible = 0;
+    for (int view = 0; view < options.views; ++view) {
+        // Cameras inside and around the field, looking at random points in it
+        glm::vec3 eye = glm::normalize(glm::vec3(unit(gen), unit(gen), unit(gen) + 0.01f)) * radius * distance(gen);
+        glm::vec3 target = glm::vec3(unit(gen), unit(gen), unit(gen)) * radius * 0.5f;
+        Frustum frustum = extractFrustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+        start = std::chrono::steady_clock::now();
+        size_t count = bvh.cull(frustum, visible.data());
+        bvhCull += secondsSince(start);
+        bvhVisible += count;
+        start = std::chrono::steady_clock::now();
+        size_t linearCount = linear.cull(frustum, visible.data(), bestCullKernel());
+        linearCull += secondsSince(start);
+        linearVisible += linearCount;
+        if (count != linearCount)
+            std::cerr << std::format("View {}: the BVH found {} visible boxes, the linear culler {}", view, count, linearCount) << std::endl;
+    }
+    std::cout << std::format("Cull: {:.2f} ms per view with the BVH, {:.2f} ms linear ({}), {:.1f}% of the boxes visible",
+        bvhCull * 1000.0 / options.views, linearCull * 1000.0 / options.views, cullKernelName(bestCullKernel()),
+        100.0 * bvhVisible / ((double)options.views * boxes.size())) << std::endl;
+    if (bvhVisible != linearVisible)
+        return 1;
+
+    // --- Rays from outside the field towards points in it, checked against a linear scan for a few ---
+    std::vector<glm::vec3> origins(options.rays), directions(options.rays);
+    for (int i = 0; i < options.rays; ++i) {
+        origins[i] = glm::normalize(glm::vec3(unit(gen), unit(gen), unit(gen) + 0.01f)) * radius * 1.2f;
+        directions[i] = glm::vec3(unit(gen), unit(gen), unit(gen)) * radius * 0.5f - origins[i];
+    }
+    start = std::chrono::steady_clock::now();
+    int hits = 0;
+    BvhRayHit hit;
+    for (int i = 0; i < options.rays; ++i)
+        hits += bvh.raycast(origins[i], directions[i], 1.0f, hit);
+    double rays = secondsSince(start);
+    std::cout << std::format("Rays: {:.2f} M rays/s, {} of {} hit", options.rays / rays / 1e6, hits, options.rays) << std::endl;
+
+    int checked = std::min(options.rays, 32);
+    for (int i = 0; i < checked; ++i) {
+        BvhRayHit bvhHit, linearHit;
+        bool bvhFound = bvh.raycast(origins[i], directions[i], 1.0f, bvhHit);
+        bool linearFound = raycastLinear(boxes, origins[i], directions[i], 1.0f, linearHit);
+        if (bvhFound != linearFound || (bvhFound && bvhHit.distance != linearHit.distance)) {
+            std::cerr << std::format("Ray {}: the BVH and the linear scan disagree", i) << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,125 @@
+// --- Frustum culling benchmark ---
+// Times the scalar, SSE and AVX kernels of the FrustumCuller (see src/FrustumCuller.h) over random
+// boxes seen from random cameras, on one thread and spread over a job system, and checks that every
+// kernel the CPU supports lists exactly the boxes the scalar kernel does.
+//
+// Usage: CullBench [--boxes <count>] [--threads <count>] [--views <count>]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+namespace {
+    struct Options {
+        size_t boxes = 1000000;
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+        int views = 64;
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--boxes" && i + 1 < argc) {
+                options.boxes = std::max<size_t>(1, std::strtoull(argv[++i], NULL, 10));
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::max(1ul, std::strtoul(argv[++i], NULL, 10));
+            } else if (arg == "--views" && i + 1 < argc) {
+                options.views = std::max(1, std::atoi(argv[++i]));
+            } else {
+                std::cerr << "Usage: CullBench [--boxes <count>] [--threads <count>] [--views <count>]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // Boxes scattered through a cube, sized like the rotated cubes of Cubey's field
+    const float radius = 200.0f;
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> halfSize(0.25f, 0.85f);
+    FrustumCuller culler;
+    culler.reserve(options.boxes);
+    for (size_t i = 0; i < options.boxes; ++i)
+        culler.addBox(glm::vec3(unit(gen), unit(gen), unit(gen)) * radius, glm::vec3(halfSize(gen), halfSize(gen), halfSize(gen)));
+
+    // Cameras inside and around the boxes, looking at random points among them
+    std::vector<Frustum> frustums(options.views);
+    std::uniform_real_distribution<float> distance(0.2f, 1.5f);
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, radius * 4.0f);
+    for (Frustum& frustum : frustums) {
+        glm::vec3 eye = glm::normalize(glm::vec3(unit(gen), unit(gen), unit(gen) + 0.01f)) * radius * distance(gen);
+        glm::vec3 target = glm::vec3(unit(gen), unit(gen), unit(gen)) * radius * 0.5f;
+        frustum = extractFrustum(projection * glm::lookAt(eye, target, glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+
+    JobSystem jobs;
+    jobs.init((int)options.threads - 1);
+    std::cout << std::format("{} boxes, {} views, {} threads", options.boxes, options.views, options.threads) << std::endl;
+
+    // The scalar kernel's lists are the reference
+    std::vector<std::vector<uint32_t>> expected(options.views);
+    size_t visibleTotal = 0;
+    for (int view = 0; view < options.views; ++view) {
+        expected[view].resize(options.boxes);
+        expected[view].resize(culler.cull(frustums[view], expected[view].data(), CullKernel::Scalar));
+        visibleTotal += expected[view].size();
+    }
+    std::cout << std::format("{:.1f}% of the boxes visible", 100.0 * visibleTotal / ((double)options.views * options.boxes)) << std::endl;
+
+    int result = 0;
+    std::vector<uint32_t> visible(options.boxes);
+    double scalarSerial = 0.0;
+    for (CullKernel kernel : { CullKernel::Scalar, CullKernel::Sse, CullKernel::Avx }) {
+        if (supportedCullKernel(kernel) != kernel) {
+            std::cout << std::format("{}: not supported by this CPU", cullKernelName(kernel)) << std::endl;
+            continue;
+        }
+        double serial = 0.0, parallel = 0.0;
+        int mismatches = 0;
+        for (int view = 0; view < options.views; ++view) {
+            const std::vector<uint32_t>& reference = expected[view];
+            auto start = std::chrono::steady_clock::now();
+            size_t count = culler.cull(frustums[view], visible.data(), kernel);
+            serial += secondsSince(start);
+            if (count != reference.size() || !std::equal(reference.begin(), reference.end(), visible.begin()))
+                mismatches++;
+            start = std::chrono::steady_clock::now();
+            count = culler.cull(frustums[view], visible.data(), kernel, jobs);
+            parallel += secondsSince(start);
+            if (count != reference.size() || !std::equal(reference.begin(), reference.end(), visible.begin()))
+                mismatches++;
+        }
+        if (kernel == CullKernel::Scalar)
+            scalarSerial = serial;
+        std::cout << std::format("{:7} {:6.2f} ms per view on 1 thread ({:.1f}x scalar), {:6.2f} ms on {}",
+            std::string(cullKernelName(kernel)) + ":", serial * 1000.0 / options.views, scalarSerial / serial,
+            parallel * 1000.0 / options.views, options.threads) << std::endl;
+        if (mismatches != 0) {
+            std::cerr << std::format("{}: {} lists differ from the scalar kernel's", cullKernelName(kernel), mismatches) << std::endl;
+            result = 1;
+        }
+    }
+    return result;
+}
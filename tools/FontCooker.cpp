@@ -0,0 +1,195 @@
+// --- Font cooker ---
+// Build-time tool that rasterizes a range of codepoints from a TTF and writes them, with their
+// metrics, to a cooked atlas file (see src/FontAtlasFile.h) that Cubey can map with --font-atlas.
+//
+// Usage: FontCooker <font.ttf> <out.atlas> [--size <pixels>] [--sdf] [--atlas-size <w>x<h>] [--range <first>-<last>]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "FontAtlasFile.h"
+#include "GlyphRaster.h"
+
+namespace {
+    // Matches the padding GlyphCache leaves around runtime glyphs
+    const int GlyphPadding = 1;
+
+    struct Options {
+        const char* fontPath = nullptr;
+        const char* outputPath = nullptr;
+        float pixelHeight = 48.0f;
+        GlyphRaster raster = GlyphRaster::Coverage;
+        int atlasWidth = 512, atlasHeight = 512;
+        uint32_t firstCodepoint = 32, lastCodepoint = 126;
+    };
+
+    struct CookedGlyph {
+        FontAtlasGlyph record;
+        RasterizedGlyph raster;
+    };
+
+    void printUsage() {
+        std::cerr << "Usage: FontCooker <font.ttf> <out.atlas> [--size <pixels>] [--sdf] [--atlas-size <w>x<h>] [--range <first>-<last>]" << std::endl;
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        int positional = 0;
+        for (int i = 1; i < argc; ++i) {
+            const char* arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (std::strcmp(arg, "--sdf") == 0) {
+                options.raster = GlyphRaster::SignedDistance;
+            } else if (std::strcmp(arg, "--size") == 0 && hasValue) {
+                options.pixelHeight = (float)std::atof(argv[++i]);
+                if (options.pixelHeight <= 0.0f) {
+                    std::cerr << "Invalid pixel size: " << argv[i] << std::endl;
+                    return false;
+                }
+            } else if (std::strcmp(arg, "--atlas-size") == 0 && hasValue) {
+                if (std::sscanf(argv[++i], "%dx%d", &options.atlasWidth, &options.atlasHeight) != 2
+                    || options.atlasWidth <= 0 || options.atlasHeight <= 0 || options.atlasWidth > 65535 || options.atlasHeight > 65535) {
+                    std::cerr << "Invalid atlas size: " << argv[i] << std::endl;
+                    return false;
+                }
+            } else if (std::strcmp(arg, "--range") == 0 && hasValue) {
+                unsigned first, last;
+                if (std::sscanf(argv[++i], "%u-%u", &first, &last) != 2 || first > last || last > 0x10FFFF) {
+                    std::cerr << "Invalid codepoint range: " << argv[i] << std::endl;
+                    return false;
+                }
+                options.firstCodepoint = first;
+                options.lastCodepoint = last;
+            } else if (arg[0] != '-' && positional < 2) {
+                (positional++ == 0 ? options.fontPath : options.outputPath) = arg;
+            } else {
+                std::cerr << "Unknown option: " << arg << std::endl;
+                return false;
+            }
+        }
+        if (positional != 2) {
+            printUsage();
+            return false;
+        }
+        return true;
+    }
+
+    bool readFile(const char* path, std::vector<unsigned char>& data) {
+        FILE* file = std::fopen(path, "rb");
+        if (!file) {
+            std::cerr << "Failed to open: " << path << std::endl;
+            return false;
+        }
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+        data.resize(size > 0 ? (size_t)size : 0);
+        bool ok = size > 0 && std::fread(data.data(), 1, data.size(), file) == data.size();
+        std::fclose(file);
+        if (!ok)
+            std::cerr << "Failed to read: " << path << std::endl;
+        return ok;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    std::vector<unsigned char> fontData;
+    if (!readFile(options.fontPath, fontData))
+        return 1;
+    stbtt_fontinfo font;
+    if (!stbtt_InitFont(&font, fontData.data(), stbtt_GetFontOffsetForIndex(fontData.data(), 0))) {
+        std::cerr << "Failed to parse font: " << options.fontPath << std::endl;
+        return 1;
+    }
+    float scale = stbtt_ScaleForPixelHeight(&font, options.pixelHeight);
+
+    // Rasterize every codepoint of the range the font has. The runtime rasterizes any other codepoint
+    // from the TTF when it is first drawn, and codepoints the font lacks as .notdef.
+    std::vector<CookedGlyph> glyphs;
+    for (uint32_t codepoint = options.firstCodepoint; codepoint <= options.lastCodepoint; ++codepoint) {
+        int glyphIndex = stbtt_FindGlyphIndex(&font, (int)codepoint);
+        if (glyphIndex == 0)
+            continue;
+        CookedGlyph glyph;
+        rasterizeGlyph(font, scale, options.raster, glyphIndex, glyph.raster);
+        glyph.record = FontAtlasGlyph();
+        glyph.record.codepoint = codepoint;
+        glyph.record.xoff = (float)glyph.raster.xoff;
+        glyph.record.yoff = (float)glyph.raster.yoff;
+        glyph.record.xadvance = glyph.raster.xadvance;
+        glyphs.push_back(std::move(glyph));
+    }
+
+    // Shelf-pack the tallest glyphs first so each shelf wastes little height
+    std::vector<CookedGlyph*> order;
+    for (CookedGlyph& glyph : glyphs)
+        order.push_back(&glyph);
+    std::stable_sort(order.begin(), order.end(), [](const CookedGlyph* a, const CookedGlyph* b) {
+        return a->raster.height > b->raster.height;
+    });
+    int cursorX = 0, shelfY = 0, shelfHeight = 0;
+    for (CookedGlyph* glyph : order) {
+        int w = glyph->raster.width, h = glyph->raster.height;
+        if (w == 0 || h == 0)
+            continue; // Blank glyphs such as space only need their metrics
+        if (cursorX + w + GlyphPadding > options.atlasWidth) {
+            shelfY += shelfHeight;
+            cursorX = shelfHeight = 0;
+        }
+        if (w + GlyphPadding > options.atlasWidth || shelfY + h + GlyphPadding > options.atlasHeight) {
+            std::cerr << "Glyphs don't fit in a " << options.atlasWidth << "x" << options.atlasHeight << " atlas" << std::endl;
+            return 1;
+        }
+        glyph->record.x0 = (uint16_t)cursorX;
+        glyph->record.y0 = (uint16_t)shelfY;
+        glyph->record.x1 = (uint16_t)(cursorX + w);
+        glyph->record.y1 = (uint16_t)(shelfY + h);
+        cursorX += w + GlyphPadding;
+        shelfHeight = std::max(shelfHeight, h + GlyphPadding);
+    }
+    int usedHeight = shelfY + shelfHeight;
+
+    std::vector<unsigned char> pixels((size_t)options.atlasWidth * usedHeight, 0);
+    for (const CookedGlyph& glyph : glyphs) {
+        for (int row = 0; row < glyph.raster.height; ++row)
+            std::copy_n(&glyph.raster.pixels[(size_t)row * glyph.raster.width], glyph.raster.width,
+                        &pixels[(size_t)(glyph.record.y0 + row) * options.atlasWidth + glyph.record.x0]);
+    }
+
+    FontAtlasHeader header;
+    std::memcpy(header.magic, FontAtlasMagic, sizeof(header.magic));
+    header.version = FontAtlasVersion;
+    header.raster = (uint32_t)options.raster;
+    header.pixelHeight = options.pixelHeight;
+    header.atlasWidth = (uint32_t)options.atlasWidth;
+    header.atlasHeight = (uint32_t)options.atlasHeight;
+    header.usedHeight = (uint32_t)usedHeight;
+    header.glyphCount = (uint32_t)glyphs.size();
+
+    FILE* output = std::fopen(options.outputPath, "wb");
+    if (!output) {
+        std::cerr << "Failed to create: " << options.outputPath << std::endl;
+        return 1;
+    }
+    bool ok = std::fwrite(&header, sizeof(header), 1, output) == 1;
+    for (const CookedGlyph& glyph : glyphs)
+        ok = ok && std::fwrite(&glyph.record, sizeof(glyph.record), 1, output) == 1;
+    ok = ok && (pixels.empty() || std::fwrite(pixels.data(), pixels.size(), 1, output) == 1);
+    ok = (std::fclose(output) == 0) && ok;
+    if (!ok) {
+        std::cerr << "Failed to write: " << options.outputPath << std::endl;
+        return 1;
+    }
+
+    std::cout << "Cooked " << glyphs.size() << " glyphs at " << options.pixelHeight << "px"
+              << (options.raster == GlyphRaster::SignedDistance ? " (SDF)" : "") << " into " << options.outputPath
+              << ": " << options.atlasWidth << "x" << options.atlasHeight << " atlas, " << usedHeight << " rows used" << std::endl;
+    return 0;
+}
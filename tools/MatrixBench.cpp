@@ -0,0 +1,136 @@
+// --- Matrix benchmark ---
+// Times building model and model-view-projection matrices for many transforms with glm, one
+// transform at a time, against the batched kernels of src/MatrixBatch.h, and checks that every
+// kernel the CPU supports agrees with glm.
+//
+// Usage: MatrixBench [--transforms <count>] [--repeat <count>]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "MatrixBatch.h"
+
+namespace {
+    struct Options {
+        size_t transforms = 1000000;
+        int repeat = 5; // Best of this many runs
+    };
+
+    struct Timing {
+        double compose = 0.0;  // Seconds for the model matrices
+        double multiply = 0.0; // And for multiplying them by the view-projection
+    };
+
+    double secondsSince(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    float maxDifference(const std::vector<glm::mat4>& a, const std::vector<glm::mat4>& b) {
+        float difference = 0.0f;
+        for (size_t i = 0; i < a.size(); ++i) {
+            for (int column = 0; column < 4; ++column) {
+                for (int row = 0; row < 4; ++row)
+                    difference = std::max(difference, std::fabs(a[i][column][row] - b[i][column][row]));
+            }
+        }
+        return difference;
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--transforms" && i + 1 < argc) {
+                options.transforms = std::max<size_t>(1, std::strtoull(argv[++i], NULL, 10));
+            } else if (arg == "--repeat" && i + 1 < argc) {
+                options.repeat = std::max(1, std::atoi(argv[++i]));
+            } else {
+                std::cerr << "Usage: MatrixBench [--transforms <count>] [--repeat <count>]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    // Random transforms, one array per component
+    const size_t count = options.transforms;
+    std::vector<float> components[10];
+    for (std::vector<float>& component : components)
+        component.resize(count);
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_real_distribution<float> scale(0.5f, 2.0f);
+    for (size_t i = 0; i < count; ++i) {
+        glm::quat rotation = glm::normalize(glm::quat(unit(gen), unit(gen), unit(gen), unit(gen) + 2.0f));
+        float values[10] = { position(gen), position(gen), position(gen), rotation.x, rotation.y, rotation.z, rotation.w,
+                             scale(gen), scale(gen), scale(gen) };
+        for (int c = 0; c < 10; ++c)
+            components[c][i] = values[c];
+    }
+    TransformArrays transforms = { components[0].data(), components[1].data(), components[2].data(),
+                                   components[3].data(), components[4].data(), components[5].data(), components[6].data(),
+                                   components[7].data(), components[8].data(), components[9].data(), count };
+    glm::mat4 viewProjection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 1000.0f) *
+                               glm::lookAt(glm::vec3(0.0f, 50.0f, 300.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+    // --- glm, a transform at a time, as the render loop builds its model matrix ---
+    std::vector<glm::mat4> glmModels(count), glmMvps(count);
+    Timing glmTiming = { 1e30, 1e30 };
+    for (int run = 0; run < options.repeat; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i]));
+            model = model * glm::mat4_cast(glm::quat(transforms.rotationW[i], transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i]));
+            glmModels[i] = glm::scale(model, glm::vec3(transforms.scaleX[i], transforms.scaleY[i], transforms.scaleZ[i]));
+        }
+        glmTiming.compose = std::min(glmTiming.compose, secondsSince(start));
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < count; ++i)
+            glmMvps[i] = viewProjection * glmModels[i];
+        glmTiming.multiply = std::min(glmTiming.multiply, secondsSince(start));
+    }
+    std::cout << std::format("{} transforms, best of {} runs", count, options.repeat) << std::endl;
+    std::cout << std::format("glm:    compose {:6.2f} ms, multiply {:6.2f} ms", glmTiming.compose * 1000.0, glmTiming.multiply * 1000.0) << std::endl;
+
+    // --- The batched kernels ---
+    int result = 0;
+    std::vector<glm::mat4> models(count), mvps(count);
+    for (MatrixKernel kernel : { MatrixKernel::Scalar, MatrixKernel::Sse, MatrixKernel::Avx2 }) {
+        if (supportedMatrixKernel(kernel) != kernel) {
+            std::cout << std::format("{}: not supported by this CPU", matrixKernelName(kernel)) << std::endl;
+            continue;
+        }
+        Timing timing = { 1e30, 1e30 };
+        for (int run = 0; run < options.repeat; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            composeTransforms(transforms, models.data(), kernel);
+            timing.compose = std::min(timing.compose, secondsSince(start));
+            start = std::chrono::steady_clock::now();
+            multiplyTransforms(viewProjection, models.data(), mvps.data(), count, kernel);
+            timing.multiply = std::min(timing.multiply, secondsSince(start));
+        }
+        float modelError = maxDifference(models, glmModels), mvpError = maxDifference(mvps, glmMvps);
+        std::cout << std::format("{:7} compose {:6.2f} ms ({:.1f}x), multiply {:6.2f} ms ({:.1f}x), max difference from glm {:.2g} / {:.2g}",
+            std::string(matrixKernelName(kernel)) + ":", timing.compose * 1000.0, glmTiming.compose / timing.compose,
+            timing.multiply * 1000.0, glmTiming.multiply / timing.multiply, modelError, mvpError) << std::endl;
+        // Positions reach 100 and the projection scales them further, so allow for rounding at that size
+        if (modelError > 1e-4f || mvpError > 1e-3f)
+            result = 1;
+    }
+    return result;
+}
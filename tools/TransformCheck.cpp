@@ -0,0 +1,198 @@
+// --- Transform check ---
+// Checks the world matrices of the TransformStore (see src/TransformStore.h) against a naive
+// recompute that walks every transform up to its root with glm. A small hand-built hierarchy covers
+// parents, a dirty node in the middle of it, re-parenting and detaching, and counts what update()
+// rebuilds; a large random hierarchy, dirtied at random, covers the SIMD runs and the threaded
+// update. Every kernel the CPU supports is checked.
+//
+// Usage: TransformCheck [--transforms <count>] [--rounds <count>] [--threads <count>]
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "TransformStore.h"
+
+namespace {
+    struct Options {
+        size_t transforms = 100000;
+        int rounds = 8;
+        unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    };
+
+    glm::mat4 localMatrix(const TransformStore& store, TransformId id) {
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), store.position(id)) * glm::mat4_cast(store.rotation(id));
+        return glm::scale(local, store.scale(id));
+    }
+
+    // Parent by parent up to the root, without using any matrix the store computed
+    glm::mat4 naiveWorld(const TransformStore& store, TransformId id) {
+        glm::mat4 world = localMatrix(store, id);
+        for (TransformId parent = store.parent(id); parent != NoTransform; parent = store.parent(parent))
+            world = localMatrix(store, parent) * world;
+        return world;
+    }
+
+    // Largest difference between the store's world matrices and the naive ones, relative to the
+    // size of the naive entry once that is above 1
+    float worldError(const TransformStore& store) {
+        float error = 0.0f;
+        for (TransformId id = 0; id < store.size(); ++id) {
+            glm::mat4 expected = naiveWorld(store, id);
+            const glm::mat4& world = store.world(id);
+            for (int column = 0; column < 4; ++column) {
+                for (int row = 0; row < 4; ++row) {
+                    float difference = std::fabs(world[column][row] - expected[column][row]);
+                    error = std::max(error, difference / std::max(1.0f, std::fabs(expected[column][row])));
+                }
+            }
+        }
+        return error;
+    }
+
+    bool below(const TransformStore& store, TransformId id, TransformId ancestor) {
+        for (; id != NoTransform; id = store.parent(id)) {
+            if (id == ancestor)
+                return true;
+        }
+        return false;
+    }
+
+    size_t subtreeSize(const TransformStore& store, TransformId root) {
+        size_t count = 0;
+        for (TransformId id = 0; id < store.size(); ++id)
+            count += below(store, id, root);
+        return count;
+    }
+
+    void randomize(TransformStore& store, TransformId id, std::mt19937& gen) {
+        std::uniform_real_distribution<float> position(-2.0f, 2.0f);
+        std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        std::uniform_real_distribution<float> scale(0.8f, 1.25f);
+        glm::quat rotation = glm::normalize(glm::quat(unit(gen), unit(gen), unit(gen), unit(gen) + 2.0f));
+        store.set(id, glm::vec3(position(gen), position(gen), position(gen)), rotation, glm::vec3(scale(gen), scale(gen), scale(gen)));
+    }
+
+    bool parseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--transforms" && i + 1 < argc) {
+                options.transforms = std::max<size_t>(1, std::strtoull(argv[++i], NULL, 10));
+            } else if (arg == "--rounds" && i + 1 < argc) {
+                options.rounds = std::max(1, std::atoi(argv[++i]));
+            } else if (arg == "--threads" && i + 1 < argc) {
+                options.threads = std::max(1ul, std::strtoul(argv[++i], NULL, 10));
+            } else {
+                std::cerr << "Usage: TransformCheck [--transforms <count>] [--rounds <count>] [--threads <count>]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options))
+        return 1;
+
+    const float Tolerance = 1e-4f;
+    JobSystem jobs;
+    jobs.init((int)options.threads - 1);
+    int result = 0;
+    auto check = [&](const char* kernelName, const char* step, const TransformStore& store, size_t updated, size_t expectedUpdated) {
+        float error = worldError(store);
+        bool passed = error <= Tolerance && updated == expectedUpdated;
+        std::cout << std::format("{} {}: {} of {} rebuilt (expected {}), max error {:.2g}{}", kernelName, step,
+            updated, store.size(), expectedUpdated, error, passed ? "" : "  FAILED") << std::endl;
+        if (!passed)
+            result = 1;
+    };
+
+    for (MatrixKernel kernel : { MatrixKernel::Scalar, MatrixKernel::Sse, MatrixKernel::Avx2 }) {
+        const char* kernelName = matrixKernelName(kernel);
+        if (supportedMatrixKernel(kernel) != kernel) {
+            std::cout << std::format("{}: not supported by this CPU", kernelName) << std::endl;
+            continue;
+        }
+        std::mt19937 gen(1);
+
+        // --- A small hierarchy ---
+        //   0 ── 1 ── 2 ── 3 ── 4      two roots, a chain under 0 with a side branch under 2,
+        //             └─ 5 ── 6        and a chain under 7
+        //   7 ── 8 ── 9
+        TransformStore store;
+        store.setMatrixKernel(kernel);
+        const TransformId parents[] = { NoTransform, 0, 1, 2, 3, 2, 5, NoTransform, 7, 8 };
+        for (TransformId parent : parents)
+            randomize(store, store.create(parent), gen);
+        check(kernelName, "built", store, store.update(), store.size());
+        check(kernelName, "unchanged", store, store.update(), 0);
+
+        // Dirtying a node in the middle rebuilds it and everything below it, and nothing else
+        randomize(store, 2, gen);
+        size_t expected = subtreeSize(store, 2);
+        check(kernelName, "middle node moved", store, store.update(), expected);
+
+        // Moving the side branch under the other root drags its child along
+        store.setParent(5, 8);
+        expected = subtreeSize(store, 5);
+        check(kernelName, "re-parented", store, store.update(), expected);
+
+        // And the old chain no longer moves it
+        randomize(store, 1, gen);
+        expected = subtreeSize(store, 1);
+        check(kernelName, "old parent moved", store, store.update(), expected);
+        randomize(store, 7, gen);
+        expected = subtreeSize(store, 7);
+        check(kernelName, "new parent moved", store, store.update(), expected);
+
+        // Detaching turns a node into a root
+        store.setParent(3, NoTransform);
+        expected = subtreeSize(store, 3);
+        check(kernelName, "detached", store, store.update(), expected);
+
+        // --- A large random hierarchy: one root in a hundred, every other transform below a random earlier one ---
+        TransformStore large;
+        large.setMatrixKernel(kernel);
+        large.reserve(options.transforms);
+        for (size_t i = 0; i < options.transforms; ++i) {
+            TransformId parent = i == 0 || gen() % 100 == 0 ? NoTransform : (TransformId)(gen() % i);
+            randomize(large, large.create(parent), gen);
+        }
+        check(kernelName, "large, built", large, large.update(&jobs), large.size());
+        for (int round = 0; round < options.rounds; ++round) {
+            // A few scattered changes and re-parentings, plus a run of neighbours for the SIMD batches
+            std::vector<uint8_t> moved(large.size(), 0);
+            for (int change = 0; change < 16; ++change) {
+                TransformId id = (TransformId)(gen() % large.size());
+                randomize(large, id, gen);
+                if (id > 0 && change % 4 == 0)
+                    large.setParent(id, (TransformId)(gen() % id));
+                moved[id] = 1;
+            }
+            TransformId run = (TransformId)(gen() % large.size());
+            for (TransformId id = run; id < std::min<size_t>(large.size(), run + 37); ++id) {
+                randomize(large, id, gen);
+                moved[id] = 1;
+            }
+            // Parents come first, so one pass in order finds everything below a moved transform
+            size_t expectedLarge = 0;
+            for (TransformId id = 0; id < large.size(); ++id) {
+                if (large.parent(id) != NoTransform && moved[large.parent(id)])
+                    moved[id] = 1;
+                expectedLarge += moved[id];
+            }
+            check(kernelName, std::format("large, round {}", round).c_str(), large, large.update(&jobs), expectedLarge);
+        }
+    }
+    return result;
+}